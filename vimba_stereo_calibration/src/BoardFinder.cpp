@@ -0,0 +1,110 @@
+#include "BoardFinder.h"
+#include "Profiler.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+//--------------------------------------------------------------
+BoardFinder::~BoardFinder()
+{
+	stop();
+}
+
+//--------------------------------------------------------------
+void BoardFinder::setup(const CameraCalibration& left, const CameraCalibration& right)
+{
+	cals[0] = left;
+	cals[1] = right;
+}
+
+//--------------------------------------------------------------
+void BoardFinder::start()
+{
+	if (!isThreadRunning()) {
+		startThread();
+	}
+}
+
+//--------------------------------------------------------------
+void BoardFinder::stop()
+{
+	if (isThreadRunning()) {
+		{
+			// under the mailbox lock, so the worker can't miss the wakeup between its check and its wait
+			std::unique_lock<std::mutex> lock(mailboxMutex);
+			stopThread();
+		}
+		mailboxCond.notify_all();
+		waitForThread(false);
+	}
+}
+
+//--------------------------------------------------------------
+void BoardFinder::post(const ofPixels& left, const ofPixels& right)
+{
+	FramePool::Ref pix[2] = {
+		pool.acquire(left.getWidth(), left.getHeight(), left.getNumChannels()),
+		pool.acquire(right.getWidth(), right.getHeight(), right.getNumChannels())
+	};
+	memcpy(pix[0]->getData(), left.getData(), left.getTotalBytes());
+	memcpy(pix[1]->getData(), right.getData(), right.getTotalBytes());
+
+	std::unique_lock<std::mutex> lock(mailboxMutex);
+	if (bMailboxFull) {
+		nDropped++;	// worker didn't get to the previous pair, replace it
+	}
+	std::swap(mailbox[0], pix[0]);	// replaced pair goes back to the pool
+	std::swap(mailbox[1], pix[1]);
+	bMailboxFull = true;
+	lock.unlock();
+	mailboxCond.notify_one();
+}
+
+//--------------------------------------------------------------
+bool BoardFinder::poll(Result& result)
+{
+	bool bGot = false;
+	while (results.tryReceive(result)) {
+		bGot = true;	// keep only the latest
+	}
+	return bGot;
+}
+
+//--------------------------------------------------------------
+void BoardFinder::threadedFunction()
+{
+	while (isThreadRunning()) {
+
+		Result result;
+
+		{
+			std::unique_lock<std::mutex> lock(mailboxMutex);
+			mailboxCond.wait(lock, [this] { return bMailboxFull || !isThreadRunning(); });
+			if (!isThreadRunning()) break;
+
+			std::swap(result.pix[0], mailbox[0]);
+			std::swap(result.pix[1], mailbox[1]);
+			bMailboxFull = false;
+			bBusy = true;
+		}
+
+		PROFILE_SCOPE("findBoard (thread)");
+
+		// search right view on a second thread while this one takes the left
+
+		auto right = std::async(std::launch::async, [&] {
+			return cals[1].findBoardCoarseToFine(toCv(*result.pix[1]), result.corners[1]);
+		});
+		bool bLeft = cals[0].findBoardCoarseToFine(toCv(*result.pix[0]), result.corners[0]);
+		bool bRight = right.get();
+
+		result.bFound = bLeft && bRight;
+		if (!result.bFound) {
+			result.corners[0].clear();
+			result.corners[1].clear();
+		}
+
+		results.send(std::move(result));
+		bBusy = false;
+	}
+}
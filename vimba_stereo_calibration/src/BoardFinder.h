@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "CameraCalibration.h"
+#include "FramePool.h"
+
+// searches stereo pairs for the calibration board on a background thread
+//	- post() drops the newest pair into a single-slot mailbox, a pair that hasn't been picked up yet is dropped
+//	- left and right views are searched in parallel, coarse-to-fine (see CameraCalibration::findBoardCoarseToFine)
+//	- results are handed back to the main thread through poll()
+
+class BoardFinder : public ofThread {
+
+	public:
+
+		struct Result {
+			bool bFound = false;
+			FramePool::Ref pix[2];					// the pair the search ran on
+			std::vector<cv::Point2f> corners[2];	// board corners per view, empty if not found
+		};
+
+		~BoardFinder();
+
+		// copies pattern and search settings, call after configuring the calibrations
+		void setup(const CameraCalibration& left, const CameraCalibration& right);
+
+		void start();
+		void stop();
+
+		// main thread: hand over the newest stereo pair (copied into pooled buffers)
+		void post(const ofPixels& left, const ofPixels& right);
+
+		// main thread: true if a search finished since the last call
+		bool poll(Result& result);
+
+		bool isBusy() const { return bBusy; }
+		int getNumDropped() const { return nDropped; }
+		uint64_t getNumAllocations() const { return pool.getNumAllocations(); }
+
+	protected:
+
+		void threadedFunction() override;
+
+		CameraCalibration cals[2];		// private copies - findBoard() isn't safe to share across threads
+
+		FramePool pool;		// declared before anything holding its Refs
+
+		std::mutex mailboxMutex;
+		std::condition_variable mailboxCond;
+		FramePool::Ref mailbox[2];
+		bool bMailboxFull = false;
+
+		ofThreadChannel<Result> results;
+
+		std::atomic<bool> bBusy{ false };
+		std::atomic<int> nDropped{ 0 };
+};
@@ -0,0 +1,251 @@
+#include "CalibrationBundle.h"
+#include "Rectifier.h"
+
+using namespace cv;
+
+const string CalibrationBundle::FILE_NAME = "stereo_calib.bin";
+
+namespace {
+
+	const char MAGIC[8] = { 'S', 'T', 'C', 'A', 'L', 'B', 'N', 'D' };
+	const uint32_t VERSION = 1;
+	const size_t ALIGN = 64;	// matrix data alignment inside the file
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t numEntries;
+		uint64_t sourceHash;
+		int32_t rotation;
+		uint32_t reserved;
+	};
+
+	struct Entry {
+		char name[16];
+		int32_t rows, cols, type;
+		uint32_t reserved;
+		uint64_t offset, bytes;
+	};
+
+	size_t align(size_t n) {
+		return (n + ALIGN - 1) / ALIGN * ALIGN;
+	}
+}
+
+//--------------------------------------------------------------
+bool CalibrationBundle::load(const string& path)
+{
+	close();
+
+	if (!file.open(path)) return false;
+
+	const uint8_t* data = file.getData();
+	size_t size = file.size();
+
+	Header header;
+	if (size < sizeof(Header)) {
+		close();
+		return false;
+	}
+	memcpy(&header, data, sizeof(Header));
+
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+		|| sizeof(Header) + header.numEntries * sizeof(Entry) > size) {
+		ofLogError("CalibrationBundle") << "not a valid calibration bundle: " << path;
+		close();
+		return false;
+	}
+
+	for (uint32_t i = 0; i < header.numEntries; i++) {
+		Entry entry;
+		memcpy(&entry, data + sizeof(Header) + i * sizeof(Entry), sizeof(Entry));
+		entry.name[sizeof(entry.name) - 1] = '\0';
+
+		uint64_t expected = uint64_t(entry.rows) * entry.cols * CV_ELEM_SIZE(entry.type);
+		if (entry.rows < 0 || entry.cols < 0 || entry.bytes != expected || entry.offset + entry.bytes > size) {
+			ofLogError("CalibrationBundle") << "corrupt entry '" << entry.name << "' in " << path;
+			close();
+			return false;
+		}
+		mats[entry.name] = Mat(entry.rows, entry.cols, entry.type, (void*)(data + entry.offset));
+	}
+
+	sourceHash = header.sourceHash;
+	rotation = header.rotation;
+	return true;
+}
+
+//--------------------------------------------------------------
+void CalibrationBundle::close()
+{
+	mats.clear();
+	file.close();
+	sourceHash = 0;
+	rotation = 0;
+}
+
+//--------------------------------------------------------------
+bool CalibrationBundle::has(const string& name) const
+{
+	return mats.count(name) > 0;
+}
+
+//--------------------------------------------------------------
+Mat CalibrationBundle::get(const string& name) const
+{
+	auto it = mats.find(name);
+	return it != mats.end() ? it->second : Mat();
+}
+
+//--------------------------------------------------------------
+bool CalibrationBundle::save(const string& path, const vector<pair<string, Mat>>& mats, uint64_t sourceHash, int nClockwiseRotations)
+{
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.numEntries = mats.size();
+	header.sourceHash = sourceHash;
+	header.rotation = ((nClockwiseRotations % 4) + 4) % 4;
+	header.reserved = 0;
+
+	vector<Entry> entries(mats.size());
+	vector<Mat> data(mats.size());
+	size_t offset = align(sizeof(Header) + entries.size() * sizeof(Entry));
+
+	for (size_t i = 0; i < mats.size(); i++) {
+		const auto& name = mats[i].first;
+		if (name.size() >= sizeof(Entry::name)) {
+			ofLogError("CalibrationBundle") << "matrix name too long: " << name;
+			return false;
+		}
+		data[i] = mats[i].second.isContinuous() ? mats[i].second : mats[i].second.clone();
+
+		Entry& entry = entries[i];
+		memset(&entry, 0, sizeof(Entry));
+		strncpy(entry.name, name.c_str(), sizeof(entry.name) - 1);
+		entry.rows = data[i].rows;
+		entry.cols = data[i].cols;
+		entry.type = data[i].type();
+		entry.offset = offset;
+		entry.bytes = data[i].total() * data[i].elemSize();
+		offset = align(offset + entry.bytes);
+	}
+
+	// write next to the target and move into place, so a half written bundle is never picked up
+
+	string tmpPath = path + ".tmp";
+	{
+		ofstream out(tmpPath, ios::binary | ios::trunc);
+		if (!out) {
+			ofLogError("CalibrationBundle") << "can't write " << tmpPath;
+			return false;
+		}
+		out.write((const char*)&header, sizeof(Header));
+		out.write((const char*)entries.data(), entries.size() * sizeof(Entry));
+		for (size_t i = 0; i < data.size(); i++) {
+			size_t pos = (size_t)out.tellp();
+			if (pos < entries[i].offset) {
+				vector<char> pad(entries[i].offset - pos, 0);
+				out.write(pad.data(), pad.size());
+			}
+			out.write((const char*)data[i].data, entries[i].bytes);
+		}
+		if (!out) {
+			ofLogError("CalibrationBundle") << "error writing " << tmpPath;
+			return false;
+		}
+	}
+	return ofFile::moveFromTo(tmpPath, path, false, true);
+}
+
+//--------------------------------------------------------------
+bool CalibrationBundle::build(const string& dir, int nClockwiseRotations)
+{
+	string calPaths[2] = { ofFilePath::join(dir, "L_calib.yml"), ofFilePath::join(dir, "R_calib.yml") };
+	string calSPath = ofFilePath::join(dir, "stereo_calib.yml");
+
+	FileStorage fsS(calSPath, FileStorage::READ);
+	if (!fsS.isOpened()) {
+		ofLogError("CalibrationBundle") << "can't build bundle, missing " << calSPath;
+		return false;
+	}
+
+	// intrinsics
+
+	Mat K[2], D[2];
+	cv::Size sz[2];
+	for (int i = 0; i < 2; i++) {
+		FileStorage fs(calPaths[i], FileStorage::READ);
+		if (!fs.isOpened()) {
+			ofLogError("CalibrationBundle") << "can't build bundle, missing " << calPaths[i];
+			return false;
+		}
+		fs["cameraMatrix"] >> K[i];
+		fs["distCoeffs"] >> D[i];
+		fs["imageSize_width"] >> sz[i].width;
+		fs["imageSize_height"] >> sz[i].height;
+	}
+
+	// stereoCalibrate may have refined them, stereo_calib.yml has the ones R / T go with
+	const char* kNames[2] = { "K0", "K1" };
+	const char* dNames[2] = { "D0", "D1" };
+	for (int i = 0; i < 2; i++) {
+		if (!fsS[kNames[i]].empty() && !fsS[dNames[i]].empty()) {
+			fsS[kNames[i]] >> K[i];
+			fsS[dNames[i]] >> D[i];
+		}
+	}
+
+	// stereo calibration + rectification
+
+	Mat R, E, F, R0, R1, P0, P1, Q;
+	Vec3d T;
+	fsS["R"] >> R;
+	fsS["T"] >> T;
+	fsS["E"] >> E;
+	fsS["F"] >> F;
+	fsS["R0"] >> R0;
+	fsS["R1"] >> R1;
+	fsS["P0"] >> P0;
+	fsS["P1"] >> P1;
+	fsS["Q"] >> Q;
+
+	Rectifier rectifiers[2];
+	rectifiers[0].setup(K[0], D[0], R0, P0, sz[0], nClockwiseRotations);
+	rectifiers[1].setup(K[1], D[1], R1, P1, sz[1], nClockwiseRotations);
+
+	vector<pair<string, Mat>> mats = {
+		{ "K0", K[0] }, { "D0", D[0] }, { "K1", K[1] }, { "D1", D[1] },
+		{ "size0", Mat(Mat_<int>(1, 2) << sz[0].width, sz[0].height) },
+		{ "size1", Mat(Mat_<int>(1, 2) << sz[1].width, sz[1].height) },
+		{ "R", R }, { "T", Mat(T) }, { "E", E }, { "F", F },
+		{ "R0", R0 }, { "R1", R1 }, { "P0", P0 }, { "P1", P1 }, { "Q", Q },
+		{ "map1_0", rectifiers[0].getMap1() }, { "map2_0", rectifiers[0].getMap2() },
+		{ "map1_1", rectifiers[1].getMap1() }, { "map2_1", rectifiers[1].getMap2() },
+	};
+
+	uint64_t hash = hashFiles({ calPaths[0], calPaths[1], calSPath });
+	string path = ofFilePath::join(dir, FILE_NAME);
+
+	if (!save(path, mats, hash, nClockwiseRotations)) {
+		return false;
+	}
+	ofLogNotice("CalibrationBundle") << "built " << path;
+	return true;
+}
+
+//--------------------------------------------------------------
+uint64_t CalibrationBundle::hashFiles(const vector<string>& paths)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (const auto& path : paths) {
+		ofBuffer buffer = ofBufferFromFile(path, true);
+		for (char c : buffer) {
+			hash ^= (uint8_t)c;
+			hash *= 1099511628211ULL;
+		}
+		hash ^= buffer.size();	// file boundary
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "MappedFile.h"
+
+// binary stereo calibration bundle (stereo_calib.bin), memory mapped on load
+//	- holds the calibration matrices (K0, D0, K1, D1, R, T, E, F, R0, R1, P0, P1, Q)
+//	  plus the precomputed fixed-point rectification maps (see Rectifier)
+//	- tied to the YAML trio it was built from by a hash of the YAML files
+
+class CalibrationBundle {
+
+	public:
+
+		static const string FILE_NAME;	// "stereo_calib.bin"
+
+		// mmap a bundle, false if missing or not a valid bundle
+		bool load(const string& path);
+		void close();
+
+		bool isLoaded() const { return file.isOpen(); }
+		uint64_t getSourceHash() const { return sourceHash; }
+		int getRotation() const { return rotation; }
+
+		// matrices are views into the mapping - clone() anything that has to outlive close()
+		bool has(const string& name) const;
+		cv::Mat get(const string& name) const;
+
+		// write mats into a new bundle
+		static bool save(const string& path, const vector<pair<string, cv::Mat>>& mats, uint64_t sourceHash, int nClockwiseRotations);
+
+		// converter: build dir/stereo_calib.bin from dir/L_calib.yml, R_calib.yml, stereo_calib.yml
+		static bool build(const string& dir, int nClockwiseRotations);
+
+		// FNV-1a over the contents of the files, in order
+		static uint64_t hashFiles(const vector<string>& paths);
+
+	protected:
+
+		MappedFile file;
+		map<string, cv::Mat> mats;
+		uint64_t sourceHash = 0;
+		int rotation = 0;
+};
@@ -0,0 +1,208 @@
+#include "CameraCalibration.h"
+
+//--------------------------------------------------------------
+void CameraCalibration::setup(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, cv::Size imageSize)
+{
+	imagePoints.clear();
+	this->distCoeffs = distCoeffs.clone();
+	addedImageSize = imageSize;
+	distortedIntrinsics.setup(cameraMatrix.clone(), imageSize);
+	updateUndistortion();
+	ready = true;
+}
+
+//--------------------------------------------------------------
+void CameraCalibration::setIntrinsics(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs)
+{
+	this->distCoeffs = distCoeffs.clone();
+	distortedIntrinsics.setup(cameraMatrix.clone(), distortedIntrinsics.getImageSize());
+	updateUndistortion();
+}
+
+//--------------------------------------------------------------
+void CameraCalibration::load(const string& filename, bool absolute)
+{
+	featurePath.clear();
+	ofxCv::Calibration::load(filename, absolute);
+}
+
+//--------------------------------------------------------------
+void CameraCalibration::loadLazy(const string& filename, bool absolute)
+{
+	resetCalibration();
+
+	string path = ofToDataPath(filename, absolute);
+	string text = ofBufferFromFile(path, true).getText();
+
+	// parse everything but the features block
+
+	size_t begin, end;
+	bool bHasFeatures = findFeatures(text, begin, end);
+	if (bHasFeatures) {
+		text.erase(begin, end - begin);
+	}
+
+	cv::FileStorage fs(text, cv::FileStorage::READ | cv::FileStorage::MEMORY);
+	if (!fs.isOpened()) {
+		ofLogError("CameraCalibration") << "can't parse " << path;
+		return;
+	}
+
+	cv::Mat cameraMatrix;
+	cv::Size imageSize, sensorSize;
+	fs["cameraMatrix"] >> cameraMatrix;
+	fs["imageSize_width"] >> imageSize.width;
+	fs["imageSize_height"] >> imageSize.height;
+	fs["sensorSize_width"] >> sensorSize.width;
+	fs["sensorSize_height"] >> sensorSize.height;
+	fs["distCoeffs"] >> distCoeffs;
+	fs["reprojectionError"] >> reprojectionError;
+
+	addedImageSize = imageSize;
+	distortedIntrinsics.setup(cameraMatrix, imageSize, sensorSize);
+	updateUndistortion();
+	ready = true;
+
+	if (bHasFeatures) {
+		featurePath = path;
+	}
+}
+
+//--------------------------------------------------------------
+void CameraCalibration::deferFeatures(const string& filename, bool absolute)
+{
+	imagePoints.clear();
+	featurePath = ofToDataPath(filename, absolute);
+}
+
+//--------------------------------------------------------------
+bool CameraCalibration::loadFeatures()
+{
+	if (featurePath.empty()) {
+		return size() > 0;
+	}
+
+	string path = featurePath;
+	featurePath.clear();
+
+	string text = ofBufferFromFile(path, true).getText();
+	size_t begin, end;
+	if (!findFeatures(text, begin, end)) {
+		ofLogError("CameraCalibration") << "no feature data in " << path;
+		return false;
+	}
+
+	// parse just the features block
+
+	cv::FileStorage fs("%YAML:1.0\n" + text.substr(begin, end - begin), cv::FileStorage::READ | cv::FileStorage::MEMORY);
+	cv::FileNode features = fs["features"];
+
+	imagePoints.clear();
+	for (cv::FileNodeIterator it = features.begin(); it != features.end(); it++) {
+		std::vector<cv::Point2f> cur;
+		(*it) >> cur;
+		imagePoints.push_back(cur);
+	}
+
+	ofLogNotice("CameraCalibration") << "loaded " << imagePoints.size() << " views from " << path;
+	return size() > 0;
+}
+
+//--------------------------------------------------------------
+void CameraCalibration::resetCalibration()
+{
+	ofxCv::Calibration::reset();
+	featurePath.clear();
+}
+
+//--------------------------------------------------------------
+bool CameraCalibration::findFeatures(const string& text, size_t& begin, size_t& end)
+{
+	begin = text.compare(0, 9, "features:") == 0 ? 0 : text.find("\nfeatures:");
+	if (begin == string::npos) return false;
+	if (text[begin] == '\n') begin++;
+
+	// block runs until the next line starting with a new top level key
+
+	end = text.find('\n', begin);
+	while (end != string::npos) {
+		end++;
+		if (end >= text.size() || (text[end] != ' ' && text[end] != '\t' && text[end] != '-' && text[end] != '\n' && text[end] != '\r')) break;
+		end = text.find('\n', end);
+	}
+	if (end == string::npos || end > text.size()) end = text.size();
+	return true;
+}
+
+//--------------------------------------------------------------
+bool CameraCalibration::add(const std::vector<cv::Point2f>& corners, cv::Size imageSize)
+{
+	if ((int)corners.size() != patternSize.area()) {
+		ofLogError("CameraCalibration") << "add() got " << corners.size() << " corners, pattern has " << patternSize.area();
+		return false;
+	}
+	addedImageSize = imageSize;
+	imagePoints.push_back(corners);
+	return true;
+}
+
+//--------------------------------------------------------------
+void CameraCalibration::setSearchSize(int searchSize)
+{
+	this->searchSize = max(0, searchSize);
+}
+
+//--------------------------------------------------------------
+bool CameraCalibration::findBoardCoarseToFine(cv::Mat img, std::vector<cv::Point2f>& pointBuf)
+{
+	int maxDim = max(img.cols, img.rows);
+	if (searchSize <= 0 || maxDim <= searchSize || patternType != ofxCv::CHESSBOARD) {
+		return findBoard(img, pointBuf);
+	}
+
+	cv::Mat gray;
+	if (img.channels() == 1) {
+		gray = img;
+	}
+	else {
+		cv::cvtColor(img, gray, img.channels() == 4 ? cv::COLOR_RGBA2GRAY : cv::COLOR_RGB2GRAY);
+	}
+
+	// coarse - same flags as findBoard(), fast-check bails early on frames without a board
+
+	cv::Mat small;
+	float scale = searchSize / float(maxDim);
+	cv::resize(gray, small, cv::Size(), scale, scale, cv::INTER_AREA);
+
+	int flags = cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_FAST_CHECK;
+	if (!cv::findChessboardCorners(small, patternSize, pointBuf, flags)) {
+		return false;
+	}
+
+	// fine - map corners back to full res (pixel centres) and refine there
+
+	float sx = gray.cols / float(small.cols);
+	float sy = gray.rows / float(small.rows);
+	for (auto& pt : pointBuf) {
+		pt.x = (pt.x + 0.5f) * sx - 0.5f;
+		pt.y = (pt.y + 0.5f) * sy - 0.5f;
+	}
+
+	// window has to cover the upscaling error
+	int reach = (int)ceil(2 * max(sx, sy));
+	cv::Size win(max(subpixelSize.width, reach), max(subpixelSize.height, reach));
+
+	cv::cornerSubPix(gray, pointBuf, win, cv::Size(-1, -1), cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 30, 0.1));
+	return true;
+}
+
+//--------------------------------------------------------------
+bool CameraCalibration::getBoardPose(size_t view, cv::Mat& rvec, cv::Mat& tvec) const
+{
+	if (!ready || view >= boardRotations.size() || view >= boardTranslations.size()) {
+		return false;
+	}
+	rvec = boardRotations[view].clone();
+	tvec = boardTranslations[view].clone();
+	return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+// ofxCv::Calibration that can also take board corners found elsewhere (e.g. by BoardFinder)
+// instead of detecting them again
+
+class CameraCalibration : public ofxCv::Calibration {
+
+	public:
+
+		using ofxCv::Calibration::add;
+
+		// set intrinsics directly (e.g. from a CalibrationBundle), clears any feature data
+		void setup(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, cv::Size imageSize);
+
+		// replace the intrinsics but keep the feature data (e.g. refined by stereoCalibrate)
+		void setIntrinsics(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs);
+
+		// ofxCv::Calibration::load(), also drops feature data deferred from an earlier load
+		void load(const string& filename, bool absolute = false);
+
+		// like load(), but the per-view feature data is left in the file until loadFeatures()
+		void loadLazy(const string& filename, bool absolute = false);
+
+		// take feature data from a calibration file on the next loadFeatures(), e.g. after setup()
+		void deferFeatures(const string& filename, bool absolute = false);
+
+		// parse deferred feature data into imagePoints, call before using imagePoints
+		// true if there's feature data
+		bool loadFeatures();
+		bool hasDeferredFeatures() const { return !featurePath.empty(); }
+
+		// ofxCv::Calibration::reset() (which isn't virtual) plus deferred feature data
+		void resetCalibration();
+
+		// add (subpixel refined) corners detected on an image of imageSize
+		bool add(const std::vector<cv::Point2f>& corners, cv::Size imageSize);
+
+		// coarse-to-fine search: images larger than searchSize (px, longest side) are searched downscaled first
+		//	0 = always search at full res
+		void setSearchSize(int searchSize);
+		int getSearchSize() const { return searchSize; }
+
+		// 1. fast-check on the downscaled image rejects frames without a board
+		// 2. corners are located at low res
+		// 3. corners are refined with subpixel accuracy at full res
+		// falls back to findBoard() for circle grids or if the image is already small
+		bool findBoardCoarseToFine(cv::Mat img, std::vector<cv::Point2f>& pointBuf);
+
+		ofxCv::CalibrationPattern getPatternType() const { return patternType; }
+
+		// board rotation (rodrigues) + translation for an added view, valid after calibrate()
+		bool getBoardPose(size_t view, cv::Mat& rvec, cv::Mat& tvec) const;
+
+	protected:
+
+		// byte range of the top level "features:" block in a calibration file's text
+		static bool findFeatures(const string& text, size_t& begin, size_t& end);
+
+		int searchSize = 0;
+		string featurePath;	// file with deferred feature data
+};
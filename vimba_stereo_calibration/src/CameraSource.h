@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ofMain.h"
+
+// a camera StereoCapture polls from its capture thread
+//	- update() / isFrameNew() / getFrame() are only called from that thread
+//	- update() may block briefly waiting for a frame (e.g. on a driver callback)
+//	- frames are in raw sensor orientation
+
+class CameraSource {
+
+	public:
+
+		virtual ~CameraSource() {}
+
+		virtual void update() = 0;
+		virtual bool isFrameNew() = 0;
+		virtual const ofPixels& getFrame() = 0;
+
+		// capture time of the current frame (usec), 0 = use the arrival time
+		virtual uint64_t getTimestamp() { return 0; }
+
+		virtual int getWidth() = 0;
+		virtual int getHeight() = 0;
+};
@@ -0,0 +1,94 @@
+#include "CaptureStore.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+//--------------------------------------------------------------
+CaptureStore::Pair& CaptureStore::add(const ofPixels& left, const ofPixels& right, const string& pathLeft, const string& pathRight,
+	vector<Point2f> cornersLeft, vector<Point2f> cornersRight)
+{
+	Pair& pair = add(pathLeft, pathRight);
+
+	const ofPixels* pix[2] = { &left, &right };
+	vector<Point2f>* corners[2] = { &cornersLeft, &cornersRight };
+	for (int i = 0; i < 2; i++) {
+		View& view = pair.views[i];
+		view.imageSize = cv::Size(pix[i]->getWidth(), pix[i]->getHeight());
+		view.corners = std::move(*corners[i]);
+		makeThumbnail(*pix[i], view.thumb);
+	}
+	pair.bSearched = true;
+	return pair;
+}
+
+//--------------------------------------------------------------
+CaptureStore::Pair& CaptureStore::add(const string& pathLeft, const string& pathRight)
+{
+	pairs.emplace_back();
+	Pair& pair = pairs.back();
+	pair.views[0].path = ofToDataPath(pathLeft, true);
+	pair.views[1].path = ofToDataPath(pathRight, true);
+	return pair;
+}
+
+//--------------------------------------------------------------
+CaptureStore::Pair& CaptureStore::add(Pair&& pair)
+{
+	pairs.push_back(std::move(pair));
+	return pairs.back();
+}
+
+//--------------------------------------------------------------
+void CaptureStore::select(const vector<size_t>& keep)
+{
+	vector<Pair> kept;
+	kept.reserve(keep.size());
+	for (size_t i : keep) {
+		kept.push_back(std::move(pairs[i]));
+	}
+	pairs = std::move(kept);
+}
+
+//--------------------------------------------------------------
+bool CaptureStore::loadImage(size_t i, int side, ofPixels& pix)
+{
+	View& view = pairs[i].views[side];
+	if (!ofLoadImage(pix, view.path)) {
+		ofLogError("CaptureStore") << "error loading " << view.path;
+		return false;
+	}
+	if (view.imageSize.area() == 0) {
+		view.imageSize = cv::Size(pix.getWidth(), pix.getHeight());
+	}
+	if (!view.thumb.isAllocated()) {
+		makeThumbnail(pix, view.thumb);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+size_t CaptureStore::getMemoryBytes() const
+{
+	size_t bytes = pairs.capacity() * sizeof(Pair);
+	for (auto& pair : pairs) {
+		for (auto& view : pair.views) {
+			bytes += view.path.capacity();
+			bytes += view.corners.capacity() * sizeof(Point2f);
+			bytes += view.thumb.getTotalBytes();
+			if (!view.rvec.empty()) bytes += view.rvec.total() * view.rvec.elemSize() + view.tvec.total() * view.tvec.elemSize();
+		}
+	}
+	return bytes;
+}
+
+//--------------------------------------------------------------
+void CaptureStore::makeThumbnail(const ofPixels& src, ofPixels& thumb) const
+{
+	if (src.getWidth() == 0 || thumbWidth <= 0) return;
+
+	int w = min<int>(thumbWidth, src.getWidth());
+	int h = max(1, int(src.getHeight() * w / src.getWidth()));
+	thumb.allocate(w, h, src.getNumChannels());
+	Mat dst = toCv(thumb);
+	resize(toCv(const_cast<ofPixels&>(src)), dst, dst.size(), 0, 0, INTER_AREA);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+// calibration pairs without their full res images
+//	- kept per view: corners, image size, board pose (once intrinsics are calibrated) and a small thumbnail
+//	- full images stay on disk and are paged in with loadImage() when needed
+//	so memory use per pair is a few KB, independent of camera resolution
+
+class CaptureStore {
+
+	public:
+
+		struct View {
+			string path;						// full res image on disk, absolute
+			cv::Size imageSize;					// 0 x 0 until the image has been read once
+			vector<cv::Point2f> corners;		// empty if no board
+			cv::Mat rvec, tvec;					// board pose in camera coords, empty until intrinsics are calibrated
+			ofPixels thumb;
+		};
+
+		struct Pair {
+			View views[2];
+			bool bSearched = false;				// false for pairs loaded from disk until their corners have been searched
+		};
+
+		void setThumbnailWidth(int width) { thumbWidth = width; }
+
+		// pair from a live search, the images are only used for size + thumbnail (they're written to disk elsewhere)
+		Pair& add(const ofPixels& left, const ofPixels& right, const string& pathLeft, const string& pathRight,
+			vector<cv::Point2f> cornersLeft, vector<cv::Point2f> cornersRight);
+
+		// pair on disk that hasn't been searched yet
+		Pair& add(const string& pathLeft, const string& pathRight);
+
+		// pair put together elsewhere (e.g. PairLoader), paths should be absolute
+		Pair& add(Pair&& pair);
+
+		// read a full res image from disk, fills in image size and thumbnail the first time
+		// different views can be loaded from different threads
+		bool loadImage(size_t i, int side, ofPixels& pix);
+
+		// keep only the pairs at these (ascending) indices, files on disk are left alone
+		void select(const vector<size_t>& keep);
+
+		void clear() { pairs.clear(); }
+		size_t size() const { return pairs.size(); }
+		bool empty() const { return pairs.empty(); }
+		Pair& operator[](size_t i) { return pairs[i]; }
+		const Pair& operator[](size_t i) const { return pairs[i]; }
+		vector<Pair>::iterator begin() { return pairs.begin(); }
+		vector<Pair>::iterator end() { return pairs.end(); }
+
+		// bytes held in memory for all pairs (not counting container overhead)
+		size_t getMemoryBytes() const;
+
+		// downscaled copy at the store's thumbnail width, safe to call from any thread
+		void makeThumbnail(const ofPixels& src, ofPixels& thumb) const;
+
+	protected:
+
+		vector<Pair> pairs;
+		int thumbWidth = 128;
+};
@@ -0,0 +1,147 @@
+#include "CoverageIndex.h"
+
+using namespace cv;
+
+//--------------------------------------------------------------
+void CoverageIndex::setup(cv::Size patternSize, int positionBins, int sizeBins, int tiltBins)
+{
+	this->patternSize = patternSize;
+	this->positionBins = max(1, positionBins);
+	this->sizeBins = max(1, sizeBins);
+	this->tiltBins = max(1, tiltBins);
+
+	int cellsPerView = this->positionBins * this->positionBins * this->sizeBins * this->tiltBins * this->tiltBins;
+	counts.assign(2 * cellsPerView, 0);
+	nCovered = 0;
+}
+
+//--------------------------------------------------------------
+bool CoverageIndex::getPose(const vector<Point2f>& corners, cv::Size imageSize, Pose& pose) const
+{
+	if ((int)corners.size() != patternSize.area() || imageSize.area() == 0) return false;
+
+	// outer corners of the grid, going round it
+	int w = patternSize.width, h = patternSize.height;
+	Point2f quad[4] = { corners[0], corners[w - 1], corners[h * w - 1], corners[(h - 1) * w] };
+
+	// detection order can come out rotated (180 deg on symmetric boards) or transposed:
+	// start at the top left in the image and go clockwise, so tilt means the same for every detection
+	int first = 0;
+	for (int k = 1; k < 4; k++) {
+		if (quad[k].x + quad[k].y < quad[first].x + quad[first].y) first = k;
+	}
+	std::rotate(quad, quad + first, quad + 4);
+	float winding = 0;
+	for (int k = 0; k < 4; k++) {
+		winding += quad[k].x * quad[(k + 1) % 4].y - quad[(k + 1) % 4].x * quad[k].y;
+	}
+	if (winding < 0) std::swap(quad[1], quad[3]);	// counter clockwise (y down)
+
+	const Point2f& a = quad[0];		// top left
+	const Point2f& b = quad[1];		// top right
+	const Point2f& c = quad[2];		// bottom right
+	const Point2f& d = quad[3];		// bottom left
+
+	Point2f centre = (a + b + c + d) * 0.25f;
+	pose.x = centre.x / imageSize.width;
+	pose.y = centre.y / imageSize.height;
+
+	// quad area, shoelace
+	float area = 0.5f * abs((a.x * b.y - b.x * a.y) + (b.x * c.y - c.x * b.y) + (c.x * d.y - d.x * c.y) + (d.x * a.y - a.x * d.y));
+	pose.size = sqrt(area / imageSize.area());
+
+	// foreshortening - the edge further from the camera is shorter
+	float top = (float)norm(b - a), bottom = (float)norm(c - d);
+	float left = (float)norm(d - a), right = (float)norm(c - b);
+	pose.tiltX = (left - right) / max(left + right, 1e-6f);
+	pose.tiltY = (top - bottom) / max(top + bottom, 1e-6f);
+	return true;
+}
+
+//--------------------------------------------------------------
+int CoverageIndex::getCell(const Pose& pose) const
+{
+	auto bin = [](float v, float lo, float hi, int n) {
+		return (int)ofClamp(int((v - lo) / (hi - lo) * n), 0, n - 1);
+	};
+
+	int x = bin(pose.x, 0, 1, positionBins);
+	int y = bin(pose.y, 0, 1, positionBins);
+	int s = bin(pose.size, minSize, maxSize, sizeBins);
+	int tx = bin(pose.tiltX, -maxTilt, maxTilt, tiltBins);
+	int ty = bin(pose.tiltY, -maxTilt, maxTilt, tiltBins);
+
+	return (((x * positionBins + y) * sizeBins + s) * tiltBins + tx) * tiltBins + ty;
+}
+
+//--------------------------------------------------------------
+void CoverageIndex::getCells(const CaptureStore::Pair& pair, int cells[2]) const
+{
+	int cellsPerView = (int)counts.size() / 2;
+	for (int i = 0; i < 2; i++) {
+		Pose pose;
+		cells[i] = getPose(pair.views[i].corners, pair.views[i].imageSize, pose) ? getCell(pose) + i * cellsPerView : -1;
+	}
+}
+
+//--------------------------------------------------------------
+bool CoverageIndex::addsCoverage(const CaptureStore::Pair& pair) const
+{
+	int cells[2];
+	getCells(pair, cells);
+	for (int cell : cells) {
+		if (cell >= 0 && counts[cell] == 0) return true;
+	}
+	return false;
+}
+
+//--------------------------------------------------------------
+void CoverageIndex::add(const CaptureStore::Pair& pair)
+{
+	int cells[2];
+	getCells(pair, cells);
+	for (int cell : cells) {
+		if (cell < 0) continue;
+		if (counts[cell]++ == 0) nCovered++;
+	}
+}
+
+//--------------------------------------------------------------
+vector<size_t> CoverageIndex::selectInformative(const CaptureStore& store) const
+{
+	// pairs with the board in both views and their cells
+
+	vector<size_t> candidates;
+	vector<array<int, 2>> cells;
+	for (size_t i = 0; i < store.size(); i++) {
+		array<int, 2> c;
+		getCells(store[i], c.data());
+		if (c[0] < 0 || c[1] < 0) continue;
+		candidates.push_back(i);
+		cells.push_back(c);
+	}
+
+	// greedy set cover
+
+	vector<bool> covered(counts.size(), false);
+	vector<bool> used(candidates.size(), false);
+	vector<size_t> selected;
+	while (true) {
+		int best = -1, bestGain = 0;
+		for (size_t k = 0; k < candidates.size(); k++) {
+			if (used[k]) continue;
+			int gain = !covered[cells[k][0]] + !covered[cells[k][1]];
+			if (gain > bestGain) {
+				best = (int)k;
+				bestGain = gain;
+			}
+		}
+		if (best < 0) break;
+		used[best] = true;
+		covered[cells[best][0]] = covered[cells[best][1]] = true;
+		selected.push_back(candidates[best]);
+	}
+
+	sort(selected.begin(), selected.end());
+	return selected;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "CaptureStore.h"
+
+// which board poses a set of calibration pairs covers, from the detected corners alone (no intrinsics needed)
+//	- per view: board centre in the image, board size and tilt (perspective foreshortening in x / y), in image orientation
+//	- each is binned, a view falls in exactly one cell, left and right views are indexed separately
+//	- a pair adds coverage if either of its views lands in a cell nothing else covers yet
+
+class CoverageIndex {
+
+	public:
+
+		struct Pose {
+			float x, y;			// board centre, 0..1 of image size
+			float size;			// sqrt of the board's area fraction of the image
+			float tiltX, tiltY;	// (left - right) / (left + right) edge length, same for top / bottom
+		};
+
+		void setup(cv::Size patternSize, int positionBins = 3, int sizeBins = 3, int tiltBins = 3);
+
+		// false if corners don't match the pattern
+		bool getPose(const vector<cv::Point2f>& corners, cv::Size imageSize, Pose& pose) const;
+
+		// cell of each view, -1 for a view without a board
+		void getCells(const CaptureStore::Pair& pair, int cells[2]) const;
+
+		bool addsCoverage(const CaptureStore::Pair& pair) const;
+		void add(const CaptureStore::Pair& pair);
+		void clear() { counts.assign(counts.size(), 0); nCovered = 0; }
+
+		// a small subset of the store covering the same cells, greedy: pairs adding the most new cells first
+		// returns store indices, in store order
+		vector<size_t> selectInformative(const CaptureStore& store) const;
+
+		int getNumCovered() const { return nCovered; }
+		int getNumCells() const { return (int)counts.size(); }	// both views
+
+	protected:
+
+		int getCell(const Pose& pose) const;
+
+		cv::Size patternSize;
+		int positionBins = 3, sizeBins = 3, tiltBins = 3;
+		float minSize = 0.15f, maxSize = 0.75f;	// board size range binned evenly, anything outside goes in the end bins
+		float maxTilt = 0.15f;					// tilt range binned evenly
+
+		vector<int> counts;		// views per cell, left cells then right cells
+		int nCovered = 0;
+};
@@ -0,0 +1,146 @@
+#include "DepthMapper.h"
+#include "Parallel.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+//--------------------------------------------------------------
+void DepthMapper::setup(const Settings& settings, const Mat& Q)
+{
+	this->settings = settings;
+	this->settings.numDisparities = max(16, (settings.numDisparities + 15) / 16 * 16);
+	this->settings.blockSize = max(settings.bSemiGlobal ? 1 : 5, settings.blockSize | 1);
+	int numStrips = settings.numStrips > 0 ? settings.numStrips : max(1, getNumberOfCPUs());
+
+	Mat Q64;
+	Q.convertTo(Q64, CV_64F);
+	q23 = Q64.at<double>(2, 3);
+	q32 = Q64.at<double>(3, 2);
+	q33 = Q64.at<double>(3, 3);
+
+	const Settings& s = this->settings;
+	strips.assign(numStrips, Strip());
+	for (auto& strip : strips) {
+		if (s.bSemiGlobal) {
+			int cn = 1;	// matching on gray
+			strip.matcher = StereoSGBM::create(s.minDisparity, s.numDisparities, s.blockSize,
+				8 * cn * s.blockSize * s.blockSize, 32 * cn * s.blockSize * s.blockSize, 1, 63, 10, 100, 2, StereoSGBM::MODE_SGBM);
+		}
+		else {
+			strip.matcher = StereoBM::create(s.numDisparities, s.blockSize);
+			strip.matcher->setMinDisparity(s.minDisparity);
+		}
+	}
+	imageSize = cv::Size();	// strips are laid out on the next frame
+}
+
+//--------------------------------------------------------------
+void DepthMapper::allocate(cv::Size size)
+{
+	imageSize = size;
+	roi = settings.roi.area() > 0 ? (settings.roi & Rect(Point(), size)) : Rect(Point(), size);
+
+	int n = (int)strips.size();
+	for (int k = 0; k < n; k++) {
+		int y0 = roi.y + roi.height * k / n;
+		int y1 = roi.y + roi.height * (k + 1) / n;
+		strips[k].rows = Rect(roi.x, y0, roi.width, y1 - y0);
+	}
+
+	disparity.create(size, CV_16S);
+	depth.create(size, CV_32F);
+	disparity.setTo((settings.minDisparity - 1) * 16);
+	depth.setTo(0);
+}
+
+//--------------------------------------------------------------
+bool DepthMapper::compute(const ofPixels& left, const ofPixels& right)
+{
+	if (strips.empty() || left.getWidth() != right.getWidth() || left.getHeight() != right.getHeight()) return false;
+
+	uint64_t t0 = ofGetElapsedTimeMicros();
+
+	cv::Size size(left.getWidth(), left.getHeight());
+	if (size != imageSize) {
+		allocate(size);
+	}
+	if (roi.area() == 0) return false;
+
+	// matching runs on gray
+	const ofPixels* pix[2] = { &left, &right };
+	Mat in[2];
+	for (int i = 0; i < 2; i++) {
+		Mat src = toCv(const_cast<ofPixels&>(*pix[i]));
+		if (src.channels() == 1) {
+			in[i] = src;
+		}
+		else {
+			cvtColor(src, gray[i], src.channels() == 4 ? COLOR_RGBA2GRAY : COLOR_RGB2GRAY);
+			in[i] = gray[i];
+		}
+	}
+
+	// matcher input per strip: strip rows + block / smoothing margin above and below,
+	// columns from far enough left of the ROI that its first column can find a match
+	int marginY = getMarginY();
+	int marginX = getMarginX();
+	int invalid = (settings.minDisparity - 1) * 16;
+
+	parallelFor(0, (int)strips.size(), [&](int k) {
+		Strip& strip = strips[k];
+		if (strip.rows.height == 0) return;
+
+		Rect rect(max(0, strip.rows.x - marginX), max(0, strip.rows.y - marginY), 0, 0);
+		rect.width = min(imageSize.width, strip.rows.x + strip.rows.width + settings.blockSize / 2) - rect.x;
+		rect.height = min(imageSize.height, strip.rows.y + strip.rows.height + marginY) - rect.y;
+
+		strip.matcher->compute(in[0](rect), in[1](rect), strip.disparity);
+
+		// keep the strip's own rows, convert to depth on the way
+		Rect out = strip.rows - rect.tl();
+		for (int y = 0; y < strip.rows.height; y++) {
+			const short* src = strip.disparity.ptr<short>(out.y + y) + out.x;
+			short* dst = disparity.ptr<short>(strip.rows.y + y) + strip.rows.x;
+			float* z = depth.ptr<float>(strip.rows.y + y) + strip.rows.x;
+			for (int x = 0; x < strip.rows.width; x++) {
+				short d = src[x];
+				dst[x] = d;
+				// Z = Q23 / (Q32 * d + Q33)
+				float w = float(q32 * (d * (1.f / 16)) + q33);
+				z[x] = (d > invalid && w != 0) ? float(q23 / w) : 0.f;
+			}
+		}
+	});
+
+	computeMs = (ofGetElapsedTimeMicros() - t0) / 1000.f;
+	return true;
+}
+
+//--------------------------------------------------------------
+Rect DepthMapper::getInputRoi(cv::Size size) const
+{
+	Rect image(Point(), size);
+	Rect r = settings.roi.area() > 0 ? (settings.roi & image) : image;
+	if (r.area() == 0) return r;
+
+	int marginX = getMarginX(), marginY = getMarginY();
+	return Rect(r.x - marginX, r.y - marginY, r.width + marginX + settings.blockSize / 2, r.height + 2 * marginY) & image;
+}
+
+//--------------------------------------------------------------
+float DepthMapper::getDepth(int x, int y) const
+{
+	if (depth.empty() || x < 0 || y < 0 || x >= depth.cols || y >= depth.rows) return 0;
+	return depth.at<float>(y, x);
+}
+
+//--------------------------------------------------------------
+void DepthMapper::getDisparityPixels(ofPixels& pix) const
+{
+	if (disparity.empty()) return;
+
+	pix.allocate(disparity.cols, disparity.rows, 1);
+	Mat dst = toCv(pix);
+	double scale = 255. / (settings.numDisparities * 16);
+	disparity.convertTo(dst, CV_8U, scale, -settings.minDisparity * 16 * scale);
+}
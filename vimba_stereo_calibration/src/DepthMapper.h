@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+// dense disparity + metric depth from rectified stereo pairs
+//	- block matching (cv::StereoBM) or semi-global matching (cv::StereoSGBM)
+//	- the ROI is split into horizontal strips matched in parallel, one matcher per strip,
+//	  strips overlap a few rows so their seams match the full frame result
+//	- depth = Z of the disparity reprojected through Q, computed in the same pass
+//	buffers are allocated on the first frame and reused
+
+class DepthMapper {
+
+	public:
+
+		struct Settings {
+			bool bSemiGlobal = true;	// SGBM, else BM
+			int minDisparity = 0;
+			int numDisparities = 128;	// search range, rounded up to a multiple of 16
+			int blockSize = 7;			// odd, BM needs >= 5
+			cv::Rect roi;				// in rectified image coords, empty = whole image
+			int numStrips = 0;			// 0 = one per core
+		};
+
+		// Q from cv::stereoRectify
+		void setup(const Settings& settings, const cv::Mat& Q);
+		bool isSetup() const { return !strips.empty(); }
+
+		// rectified left + right frames, any channel count
+		bool compute(const ofPixels& left, const ofPixels& right);
+
+		// CV_16S fixed point (disparity * 16) at full image size, < (minDisparity - 1) * 16 where invalid / outside the ROI
+		const cv::Mat& getDisparity() const { return disparity; }
+		// CV_32F depth (Z) in calibration units, 0 where invalid
+		const cv::Mat& getDepth() const { return depth; }
+		float getDepth(int x, int y) const;
+
+		// disparity scaled to 0..255 over the search range, for display
+		void getDisparityPixels(ofPixels& pix) const;
+
+		const Settings& getSettings() const { return settings; }
+		cv::Rect getRoi() const { return roi; }
+
+		// part of the rectified frames of imageSize compute() reads (both views): the ROI plus the
+		// disparity range to its left and the block / smoothing margins
+		cv::Rect getInputRoi(cv::Size imageSize) const;
+		float getComputeMs() const { return computeMs; }
+
+	protected:
+
+		struct Strip {
+			cv::Ptr<cv::StereoMatcher> matcher;
+			cv::Rect rows;		// rows of the ROI this strip outputs
+			cv::Mat disparity;	// matcher output for the strip + margins
+		};
+
+		void allocate(cv::Size imageSize);
+		int getMarginX() const { return settings.minDisparity + settings.numDisparities + settings.blockSize / 2; }
+		int getMarginY() const { return max(settings.blockSize, 16); }
+
+		Settings settings;
+		double q23 = 0, q32 = 0, q33 = 0;	// Q entries needed for Z
+
+		vector<Strip> strips;
+		cv::Size imageSize;
+		cv::Rect roi;
+		cv::Mat gray[2];	// colour frames converted for matching
+		cv::Mat disparity, depth;
+		float computeMs = 0;
+};
@@ -0,0 +1,178 @@
+#include "FaceMatcher.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+//--------------------------------------------------------------
+void FaceMatcher::setup(const Mat& Q, int maxDisparity, int redetectFrames)
+{
+	Mat Q64;
+	Q.convertTo(Q64, CV_64F);
+	q23 = Q64.at<double>(2, 3);
+	q32 = Q64.at<double>(3, 2);
+	q33 = Q64.at<double>(3, 3);
+
+	this->maxDisparity = maxDisparity;
+	this->redetectFrames = max(1, redetectFrames);
+	clear();
+}
+
+//--------------------------------------------------------------
+void FaceMatcher::update(const ofPixels& left, const ofPixels& right, ObjectFinder& finder, bool bFullFrame)
+{
+	const ofPixels* pix[2] = { &left, &right };
+	Mat in[2];
+	for (int i = 0; i < 2; i++) {
+		Mat src = toCv(const_cast<ofPixels&>(*pix[i]));
+		if (src.channels() == 1) {
+			in[i] = src;
+		}
+		else {
+			cvtColor(src, gray[i], src.channels() == 4 ? COLOR_RGBA2GRAY : COLOR_RGB2GRAY);
+			in[i] = gray[i];
+		}
+	}
+
+	// follow known faces, forget the ones we lose
+	for (auto it = tracks.begin(); it != tracks.end();) {
+		if (trackLeft(*it, in[0])) ++it;
+		else it = tracks.erase(it);
+	}
+
+	// tracks that drifted onto the same face, the older one (lower index) stays
+	for (size_t i = 0; i < tracks.size(); i++) {
+		for (size_t j = tracks.size() - 1; j > i; j--) {
+			if (isSameFace(tracks[i].face.left, tracks[j].face.left)) tracks.erase(tracks.begin() + j);
+		}
+	}
+
+	// full detector only without faces or now and then for new ones
+	// (faces all lost on a partial frame: the rest of it is stale, the next one is whole)
+	bDetected = (tracks.empty() || ++nFrames >= redetectFrames) && bFullFrame;
+	if (bDetected) {
+		nFrames = 0;
+		detect(in[0], finder);
+	}
+
+	faces.clear();
+	for (auto& track : tracks) {
+		matchRight(track, in[0], in[1]);
+		faces.push_back(track.face);
+	}
+}
+
+//--------------------------------------------------------------
+void FaceMatcher::getRois(vector<Rect>& left, vector<Rect>& right, cv::Size imageSize, int margin) const
+{
+	left.clear();
+	right.clear();
+	Rect image(Point(), imageSize);
+	for (auto& track : tracks) {
+		// the face ends up somewhere in its tracking window, its band spans the window's rows
+		Rect window = getTrackWindow(track.face.left);
+		Rect band(window.x - maxDisparity, window.y - bandSlack, window.width + maxDisparity, window.height + 2 * bandSlack);
+		left.push_back(Rect(window.x - margin, window.y - margin, window.width + 2 * margin, window.height + 2 * margin) & image);
+		right.push_back(Rect(band.x - margin, band.y - margin, band.width + 2 * margin, band.height + 2 * margin) & image);
+	}
+}
+
+//--------------------------------------------------------------
+Rect FaceMatcher::getTrackWindow(const ofRectangle& face)
+{
+	// search around the last position, half a face each way
+	Rect last = toCv(face);
+	return Rect(last.x - last.width / 2, last.y - last.height / 2, last.width * 2, last.height * 2);
+}
+
+//--------------------------------------------------------------
+bool FaceMatcher::trackLeft(Track& track, const Mat& left) const
+{
+	Rect window = getTrackWindow(track.face.left) & Rect(0, 0, left.cols, left.rows);
+	if (window.width < track.templ.cols || window.height < track.templ.rows) return false;
+
+	Mat result;
+	matchTemplate(left(window), track.templ, result, TM_CCOEFF_NORMED);
+	double maxVal;
+	Point maxLoc;
+	minMaxLoc(result, nullptr, &maxVal, nullptr, &maxLoc);
+	if (maxVal < trackThreshold) return false;
+
+	Rect found(window.tl() + maxLoc, track.templ.size());
+	track.face.left = toOf(found);
+	track.templ = left(found).clone();	// follow appearance changes
+	track.face.age++;
+	return true;
+}
+
+//--------------------------------------------------------------
+bool FaceMatcher::matchRight(Track& track, const Mat& left, const Mat& right) const
+{
+	track.face.depth = 0;
+	track.face.score = 0;
+
+	// epipolar band: same rows (+ a little slack), from up to maxDisparity px left of the face's left view x to its right edge
+	Rect l = toCv(track.face.left);
+	Rect band(l.x - maxDisparity, l.y - bandSlack, l.width + maxDisparity, l.height + 2 * bandSlack);
+	band &= Rect(0, 0, right.cols, right.rows);
+	if (band.width < l.width || band.height < l.height) return false;
+
+	Mat result;
+	matchTemplate(right(band), track.templ, result, TM_CCOEFF_NORMED);
+	double maxVal;
+	Point maxLoc;
+	minMaxLoc(result, nullptr, &maxVal, nullptr, &maxLoc);
+	track.face.score = (float)maxVal;
+	if (maxVal < matchThreshold) return false;
+
+	// subpixel x from a parabola through the peak and its neighbours
+	float dx = 0;
+	if (maxLoc.x > 0 && maxLoc.x < result.cols - 1) {
+		float a = result.at<float>(maxLoc.y, maxLoc.x - 1);
+		float b = result.at<float>(maxLoc.y, maxLoc.x);
+		float c = result.at<float>(maxLoc.y, maxLoc.x + 1);
+		float denom = a - 2 * b + c;
+		if (denom != 0) dx = 0.5f * (a - c) / denom;
+	}
+
+	float xr = band.x + maxLoc.x + dx;
+	track.face.right.set(xr, (float)(band.y + maxLoc.y), (float)l.width, (float)l.height);
+	track.face.disparity = l.x - xr;
+
+	double w = q32 * track.face.disparity + q33;
+	track.face.depth = w != 0 ? float(q23 / w) : 0.f;
+	return true;
+}
+
+//--------------------------------------------------------------
+void FaceMatcher::detect(const Mat& left, ObjectFinder& finder)
+{
+	finder.update(left);
+
+	for (unsigned int i = 0; i < finder.size(); i++) {
+		Rect detected = toCv(finder.getObject(i)) & Rect(0, 0, left.cols, left.rows);
+		if (detected.area() == 0) continue;
+
+		// same face as a track? refresh it, else start a new one
+		Track* match = nullptr;
+		for (auto& track : tracks) {
+			if (isSameFace(track.face.left, toOf(detected))) {
+				match = &track;
+				break;
+			}
+		}
+		if (!match) {
+			tracks.emplace_back();
+			match = &tracks.back();
+			match->face.id = nextId++;
+		}
+		match->face.left = toOf(detected);
+		match->templ = left(detected).clone();
+	}
+}
+
+//--------------------------------------------------------------
+bool FaceMatcher::isSameFace(const ofRectangle& a, const ofRectangle& b)
+{
+	Rect ra = toCv(a), rb = toCv(b);
+	return (ra & rb).area() > 0.3 * min(ra.area(), rb.area());
+}
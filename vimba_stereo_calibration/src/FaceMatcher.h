@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+// faces in a rectified stereo pair, detected in the left view only
+//	- right view: the left face patch is correlated along its epipolar band (same rows), disparity -> depth through Q
+//	- faces are tracked between frames by correlation around their last position, the Haar detector only runs
+//	  when there are no faces or every redetectFrames frames to pick up new ones
+//	- multiple faces, each with its own depth
+
+class FaceMatcher {
+
+	public:
+
+		struct Face {
+			int id = -1;
+			ofRectangle left, right;	// rectified image coords
+			float disparity = 0;		// px, left x - right x
+			float depth = 0;			// Z in calibration units, 0 if no match in the right view
+			float score = 0;			// right view match, normalized correlation
+			int age = 0;				// frames tracked
+		};
+
+		// Q from cv::stereoRectify
+		void setup(const cv::Mat& Q, int maxDisparity = 256, int redetectFrames = 30);
+
+		// rectified frames, detection runs on the left with finder (set up by the caller)
+		// bFullFrame false: only the getRois() parts are up to date, detection waits for the next update
+		// (willDetect() is true then)
+		void update(const ofPixels& left, const ofPixels& right, ofxCv::ObjectFinder& finder, bool bFullFrame = true);
+		void clear() { tracks.clear(); faces.clear(); }
+
+		const vector<Face>& getFaces() const { return faces; }
+		bool didDetect() const { return bDetected; }	// the detector ran on the last update
+		bool willDetect() const { return tracks.empty() || nFrames + 1 >= redetectFrames; }	// the next update runs the detector (needs the whole left frame)
+
+		// parts of the next frames the next update looks at: tracking windows (left), epipolar bands (right)
+		// grown by margin px, clipped to imageSize
+		void getRois(vector<cv::Rect>& left, vector<cv::Rect>& right, cv::Size imageSize, int margin = 8) const;
+
+	protected:
+
+		struct Track {
+			Face face;
+			cv::Mat templ;	// left view patch, gray
+		};
+
+		static cv::Rect getTrackWindow(const ofRectangle& face);
+		bool trackLeft(Track& track, const cv::Mat& left) const;
+		bool matchRight(Track& track, const cv::Mat& left, const cv::Mat& right) const;
+		void detect(const cv::Mat& left, ofxCv::ObjectFinder& finder);
+		static bool isSameFace(const ofRectangle& a, const ofRectangle& b);	// overlap over 30% of the smaller one
+
+		double q23 = 0, q32 = 0, q33 = 0;	// Q entries needed for Z
+		int maxDisparity = 256;
+		int redetectFrames = 30;
+		float trackThreshold = 0.6f, matchThreshold = 0.5f;	// min normalized correlation
+		int bandSlack = 2;		// rows above / below the face searched in the right view
+
+		vector<Track> tracks;
+		vector<Face> faces;
+		cv::Mat gray[2];
+		int nFrames = 0, nextId = 0;
+		bool bDetected = false;
+};
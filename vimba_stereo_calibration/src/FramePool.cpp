@@ -0,0 +1,48 @@
+#include "FramePool.h"
+
+std::atomic<uint64_t> FramePool::nTotalAllocations{ 0 };
+
+//--------------------------------------------------------------
+void FramePool::Ref::release()
+{
+	if (buf && --buf->refs == 0) {
+		buf->pool->recycle(buf);
+	}
+	buf = nullptr;
+}
+
+//--------------------------------------------------------------
+FramePool::Ref FramePool::acquire(size_t w, size_t h, size_t channels)
+{
+	Buffer* buf = nullptr;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (available.empty()) {
+			buffers.emplace_back(new Buffer());
+			buf = buffers.back().get();
+			buf->pool = this;
+		}
+		else {
+			buf = available.back();
+			available.pop_back();
+		}
+	}
+
+	if (buf->pix.getWidth() != w || buf->pix.getHeight() != h || buf->pix.getNumChannels() != channels) {
+		buf->pix.allocate(w, h, channels);
+		nAllocations++;
+		nTotalAllocations++;
+	}
+
+	Ref ref;
+	ref.buf = buf;
+	buf->refs = 1;
+	return ref;
+}
+
+//--------------------------------------------------------------
+void FramePool::recycle(Buffer* buf)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	available.push_back(buf);
+}
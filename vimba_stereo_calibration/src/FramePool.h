@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ofMain.h"
+
+// pool of reference counted pixel buffers
+//	- acquire() hands out a buffer, it goes back to the pool when the last Ref to it is dropped
+//	- buffers are only allocated when the pool runs dry or a frame format changes,
+//	  so in steady state getNumAllocations() stops growing
+//	- acquire() / release are thread safe, a single Ref is not
+//	- the pool has to outlive all of its Refs
+
+class FramePool {
+
+	struct Buffer {
+		ofPixels pix;
+		std::atomic<int> refs{ 0 };
+		FramePool* pool = nullptr;
+	};
+
+	public:
+
+		class Ref {
+			public:
+				Ref() {}
+				Ref(const Ref& other) : buf(other.buf) { if (buf) buf->refs++; }
+				Ref(Ref&& other) : buf(other.buf) { other.buf = nullptr; }
+				Ref& operator=(Ref other) { std::swap(buf, other.buf); return *this; }
+				~Ref() { release(); }
+
+				void release();
+
+				explicit operator bool() const { return buf != nullptr; }
+				ofPixels& operator*() const { return buf->pix; }
+				ofPixels* operator->() const { return &buf->pix; }
+
+			protected:
+				friend class FramePool;
+				Buffer* buf = nullptr;
+		};
+
+		FramePool() {}
+		FramePool(const FramePool&) = delete;
+		FramePool& operator=(const FramePool&) = delete;
+
+		// buffer allocated to w x h x channels, contents undefined
+		Ref acquire(size_t w, size_t h, size_t channels);
+
+		uint64_t getNumAllocations() const { return nAllocations; }
+		static uint64_t getTotalAllocations() { return nTotalAllocations; }
+
+	protected:
+
+		void recycle(Buffer* buf);
+
+		std::mutex mutex;
+		vector<unique_ptr<Buffer>> buffers;
+		vector<Buffer*> available;
+
+		std::atomic<uint64_t> nAllocations{ 0 };
+		static std::atomic<uint64_t> nTotalAllocations;
+};
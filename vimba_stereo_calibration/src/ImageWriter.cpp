@@ -0,0 +1,178 @@
+#include "ImageWriter.h"
+#include "Profiler.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+//--------------------------------------------------------------
+ImageWriter::~ImageWriter()
+{
+	stop();
+}
+
+//--------------------------------------------------------------
+void ImageWriter::setup(size_t numThreads, size_t maxQueued)
+{
+	stop();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	this->maxQueued = max<size_t>(1, maxQueued);
+	bRunning = true;
+	for (size_t i = 0; i < max<size_t>(1, numThreads); i++) {
+		workers.emplace_back(&ImageWriter::threadedFunction, this);
+	}
+}
+
+//--------------------------------------------------------------
+void ImageWriter::stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!bRunning) return;
+		bRunning = false;	// workers drain the queue before they exit
+	}
+	jobCond.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+}
+
+//--------------------------------------------------------------
+void ImageWriter::setFormat(const string& format, int jpegQuality)
+{
+	if (format != "jpg" && format != "png" && format != "raw") {
+		ofLogError("ImageWriter") << "unknown format " << format << ", using jpg";
+		this->format = "jpg";
+	}
+	else {
+		this->format = format;
+	}
+	this->jpegQuality = (int)ofClamp(jpegQuality, 0, 100);
+}
+
+//--------------------------------------------------------------
+string ImageWriter::getExtension(size_t numChannels) const
+{
+	if (format == "raw") {
+		return numChannels == 1 ? "pgm" : "ppm";
+	}
+	return format;
+}
+
+//--------------------------------------------------------------
+bool ImageWriter::write(const FramePool::Ref& pix, const string& path, bool absolute)
+{
+	Job job{ pix, ofToDataPath(path, absolute), format, jpegQuality };
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!bRunning || queue.size() >= maxQueued) {
+			nRejected++;
+			return false;
+		}
+		queue.push_back(std::move(job));
+	}
+	jobCond.notify_one();
+	return true;
+}
+
+//--------------------------------------------------------------
+bool ImageWriter::write(const ofPixels& pix, const string& path, bool absolute)
+{
+	if (!canWrite()) {
+		nRejected++;
+		return false;
+	}
+	FramePool::Ref copy = pool.acquire(pix.getWidth(), pix.getHeight(), pix.getNumChannels());
+	memcpy(copy->getData(), pix.getData(), pix.getTotalBytes());
+	return write(copy, path, absolute);
+}
+
+//--------------------------------------------------------------
+bool ImageWriter::canWrite(size_t n)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return bRunning && queue.size() + n <= maxQueued;
+}
+
+//--------------------------------------------------------------
+void ImageWriter::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idleCond.wait(lock, [this] { return queue.empty() && nBusy == 0; });
+}
+
+//--------------------------------------------------------------
+size_t ImageWriter::getNumQueued()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return queue.size() + nBusy;
+}
+
+//--------------------------------------------------------------
+void ImageWriter::threadedFunction()
+{
+	while (true) {
+
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobCond.wait(lock, [this] { return !queue.empty() || !bRunning; });
+			if (queue.empty()) break;	// stopped and drained
+			job = std::move(queue.front());
+			queue.pop_front();
+			nBusy++;
+		}
+
+		if (encode(job)) {
+			nWritten++;
+		}
+		else {
+			nFailed++;
+			ofLogError("ImageWriter") << "error writing " << job.path;
+		}
+		job.pix.release();
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			nBusy--;
+		}
+		idleCond.notify_all();
+	}
+}
+
+//--------------------------------------------------------------
+bool ImageWriter::encode(const Job& job)
+{
+	PROFILE_SCOPE("image write");
+
+	Mat src = toCv(*job.pix);
+
+	// imwrite wants BGR
+	Mat bgr = src;
+	if (src.channels() == 3) {
+		cvtColor(src, bgr, COLOR_RGB2BGR);
+	}
+	else if (src.channels() == 4) {
+		cvtColor(src, bgr, COLOR_RGBA2BGRA);
+	}
+
+	vector<int> params;
+	if (job.format == "jpg") {
+		params = { IMWRITE_JPEG_QUALITY, job.quality };
+	}
+	else if (job.format == "png") {
+		params = { IMWRITE_PNG_COMPRESSION, 1 };	// fastest zlib level, still lossless
+	}
+	else if (job.format == "raw") {
+		params = { IMWRITE_PXM_BINARY, 1 };
+	}
+
+	try {
+		return imwrite(job.path, bgr, params);
+	}
+	catch (const cv::Exception& e) {
+		ofLogError("ImageWriter") << e.what();
+		return false;
+	}
+}
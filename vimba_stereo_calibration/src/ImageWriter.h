@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "FramePool.h"
+
+// writes images on a small pool of encoder threads
+//	- bounded queue, write() refuses new images while it's full (back-pressure)
+//	- formats: "jpg" (small), "png" (lossless, fast compression), "raw" (uncompressed ppm / pgm, lossless, fastest)
+//	- stop() writes everything still queued before returning
+
+class ImageWriter {
+
+	public:
+
+		~ImageWriter();
+
+		void setup(size_t numThreads = 2, size_t maxQueued = 8);
+		void stop();
+
+		void setFormat(const string& format, int jpegQuality = 95);
+		const string& getFormat() const { return format; }
+		string getExtension(size_t numChannels) const;	// file extension for the current format, no dot
+
+		// queue an image, false if the queue is full or the writer isn't running
+		// Refs are held until written, plain pixels are copied
+		bool write(const FramePool::Ref& pix, const string& path, bool absolute = false);
+		bool write(const ofPixels& pix, const string& path, bool absolute = false);
+
+		// true if n more images fit in the queue right now
+		bool canWrite(size_t n = 1);
+
+		// block until everything queued so far is written
+		void flush();
+
+		size_t getNumQueued();
+		uint64_t getNumWritten() const { return nWritten; }
+		uint64_t getNumRejected() const { return nRejected; }	// refused because the queue was full
+		uint64_t getNumFailed() const { return nFailed; }
+
+	protected:
+
+		struct Job {
+			FramePool::Ref pix;
+			string path;
+			string format;
+			int quality;
+		};
+
+		void threadedFunction();
+		bool encode(const Job& job);
+
+		FramePool pool;		// copies of plain pixels, declared before the queue holding its Refs
+
+		std::mutex mutex;
+		std::condition_variable jobCond, idleCond;
+		deque<Job> queue;
+		vector<std::thread> workers;
+		size_t maxQueued = 8;
+		int nBusy = 0;
+		bool bRunning = false;
+
+		string format = "jpg";
+		int jpegQuality = 95;
+
+		std::atomic<uint64_t> nWritten{ 0 }, nRejected{ 0 }, nFailed{ 0 };
+};
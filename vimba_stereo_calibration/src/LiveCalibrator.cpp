@@ -0,0 +1,158 @@
+#include "LiveCalibrator.h"
+#include "Profiler.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+//--------------------------------------------------------------
+LiveCalibrator::~LiveCalibrator()
+{
+	stop();
+}
+
+//--------------------------------------------------------------
+void LiveCalibrator::setup(const CameraCalibration& calibration, int minPairs)
+{
+	objectPoints = Calibration::createObjectPoints(calibration.getPatternSize(), calibration.getSquareSize(), calibration.getPatternType());
+	this->minPairs = max(minPairs, 3);
+}
+
+//--------------------------------------------------------------
+void LiveCalibrator::start()
+{
+	if (!isThreadRunning()) {
+		startThread();
+	}
+}
+
+//--------------------------------------------------------------
+void LiveCalibrator::stop()
+{
+	if (isThreadRunning()) {
+		{
+			// under the mailbox lock, so the worker can't miss the wakeup between its check and its wait
+			std::unique_lock<std::mutex> lock(mailboxMutex);
+			stopThread();
+		}
+		mailboxCond.notify_all();
+		waitForThread(false);
+	}
+}
+
+//--------------------------------------------------------------
+void LiveCalibrator::reset()
+{
+	std::unique_lock<std::mutex> lock(mailboxMutex);
+	bMailboxFull = false;
+	bReset = true;
+	generation++;	// a solve already running is dropped when it arrives
+}
+
+//--------------------------------------------------------------
+void LiveCalibrator::post(const vector<vector<Point2f>>& left, const vector<vector<Point2f>>& right, cv::Size imageSize)
+{
+	if ((int)left.size() < minPairs || left.size() != right.size()) return;
+
+	std::unique_lock<std::mutex> lock(mailboxMutex);
+	mailbox.imagePoints[0] = left;
+	mailbox.imagePoints[1] = right;
+	mailbox.imageSize = imageSize;
+	mailbox.generation = generation;
+	bMailboxFull = true;
+	lock.unlock();
+	mailboxCond.notify_one();
+}
+
+//--------------------------------------------------------------
+bool LiveCalibrator::poll(Estimate& estimate)
+{
+	bool bGot = false;
+	Estimate received;
+	while (results.tryReceive(received)) {
+		if (received.generation != generation) continue;	// solved from corners before a reset()
+		estimate = std::move(received);
+		bGot = true;	// keep only the latest
+	}
+	return bGot;
+}
+
+//--------------------------------------------------------------
+void LiveCalibrator::threadedFunction()
+{
+	while (isThreadRunning()) {
+
+		Job job;
+
+		{
+			std::unique_lock<std::mutex> lock(mailboxMutex);
+			mailboxCond.wait(lock, [this] { return bMailboxFull || !isThreadRunning(); });
+			if (!isThreadRunning()) break;
+
+			std::swap(job, mailbox);
+			bMailboxFull = false;
+			if (bReset) {
+				last = Estimate();
+				bReset = false;
+			}
+			bBusy = true;
+		}
+
+		Estimate estimate;
+		estimate.generation = job.generation;
+		if (solve(job, estimate)) {
+			if (job.generation == generation) last = estimate;	// no warm start from before a reset()
+			results.send(std::move(estimate));
+		}
+		bBusy = false;
+	}
+}
+
+//--------------------------------------------------------------
+bool LiveCalibrator::solve(const Job& job, Estimate& estimate)
+{
+	PROFILE_SCOPE("live calibration");
+
+	uint64_t t0 = ofGetElapsedTimeMicros();
+
+	int n = (int)job.imagePoints[0].size();
+	vector<vector<Point3f>> objPts(n, objectPoints);
+
+	try {
+
+		// per camera, warm-started from the previous estimate
+
+		for (int i = 0; i < 2; i++) {
+			int flags = 0;
+			if (!last.K[i].empty()) {
+				estimate.K[i] = last.K[i].clone();
+				estimate.D[i] = last.D[i].clone();
+				flags |= CALIB_USE_INTRINSIC_GUESS;
+			}
+
+			vector<Mat> rvecs, tvecs;
+			Mat stdIntrinsics, stdExtrinsics, perViewErrors;
+			estimate.rms[i] = calibrateCamera(objPts, job.imagePoints[i], job.imageSize, estimate.K[i], estimate.D[i],
+				rvecs, tvecs, stdIntrinsics, stdExtrinsics, perViewErrors, flags);
+
+			// intrinsics std devs come first: fx, fy, cx, cy, then distortion
+			for (int k = 0; k < 4 && k < (int)stdIntrinsics.total(); k++) {
+				estimate.stdDev[i][k] = stdIntrinsics.at<double>(k);
+			}
+		}
+
+		// joint refinement of both cameras + extrinsics
+
+		Mat E, F;
+		estimate.stereoRms = stereoCalibrate(objPts, job.imagePoints[0], job.imagePoints[1],
+			estimate.K[0], estimate.D[0], estimate.K[1], estimate.D[1], job.imageSize, estimate.R, estimate.T, E, F,
+			CALIB_USE_INTRINSIC_GUESS, TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, 30, 1e-6));
+	}
+	catch (const cv::Exception& e) {
+		ofLogError("LiveCalibrator") << e.what();
+		return false;
+	}
+
+	estimate.nPairs = n;
+	estimate.solveMs = (ofGetElapsedTimeMicros() - t0) / 1000.f;
+	return true;
+}
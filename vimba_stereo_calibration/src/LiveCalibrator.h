@@ -0,0 +1,73 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "CameraCalibration.h"
+
+// incremental stereo calibration on a background thread
+//	- post() hands over the corners of all accepted pairs so far, a set that hasn't been picked up yet is replaced
+//	- each solve is warm-started from the previous estimate: per camera calibrateCamera() with the last K / D as guess,
+//	  then a joint stereoCalibrate() refining K0, K1, D0, D1, R, T
+//	- estimates are handed back to the main thread through poll()
+
+class LiveCalibrator : public ofThread {
+
+	public:
+
+		struct Estimate {
+			int nPairs = 0;
+			cv::Mat K[2], D[2];
+			cv::Mat R, T;
+			double rms[2] = { 0, 0 };		// per camera reprojection error (px)
+			double stereoRms = 0;			// joint reprojection error (px)
+			cv::Vec4d stdDev[2];			// standard deviation of fx, fy, cx, cy (px)
+			float solveMs = 0;
+			uint64_t generation = 0;		// reset() count when the job was posted
+		};
+
+		~LiveCalibrator();
+
+		// copies pattern settings, call after configuring the calibration
+		void setup(const CameraCalibration& calibration, int minPairs = 4);
+
+		void start();
+		void stop();
+
+		// forget the previous estimate, the next solve starts from scratch
+		void reset();
+
+		// main thread: corners of all accepted pairs, index aligned
+		void post(const vector<vector<cv::Point2f>>& left, const vector<vector<cv::Point2f>>& right, cv::Size imageSize);
+
+		// main thread: true if a solve finished since the last call, solves started before a reset() are dropped
+		bool poll(Estimate& estimate);
+
+		bool isBusy() const { return bBusy; }
+		int getMinPairs() const { return minPairs; }
+
+	protected:
+
+		struct Job {
+			vector<vector<cv::Point2f>> imagePoints[2];
+			cv::Size imageSize;
+			uint64_t generation = 0;
+		};
+
+		void threadedFunction() override;
+		bool solve(const Job& job, Estimate& estimate);
+
+		vector<cv::Point3f> objectPoints;
+		int minPairs = 4;
+
+		std::mutex mailboxMutex;
+		std::condition_variable mailboxCond;
+		Job mailbox;
+		bool bMailboxFull = false;
+		bool bReset = false;
+		std::atomic<uint64_t> generation{ 0 };	// bumped by reset(), under mailboxMutex
+
+		Estimate last;		// warm start, worker thread only
+		ofThreadChannel<Estimate> results;
+
+		std::atomic<bool> bBusy{ false };
+};
@@ -0,0 +1,75 @@
+#include "MappedFile.h"
+
+#ifndef TARGET_WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+//--------------------------------------------------------------
+bool MappedFile::open(const string& path)
+{
+	close();
+
+#ifdef TARGET_WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER sz;
+	if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		close();
+		return false;
+	}
+	data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		close();
+		return false;
+	}
+	length = (size_t)sz.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);	// the mapping keeps the file open
+	if (ptr == MAP_FAILED) return false;
+
+	data = (const uint8_t*)ptr;
+	length = st.st_size;
+#endif
+
+	return true;
+}
+
+//--------------------------------------------------------------
+void MappedFile::close()
+{
+#ifdef TARGET_WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mapping != NULL) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (data) munmap((void*)data, length);
+#endif
+	data = nullptr;
+	length = 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "ofMain.h"
+
+// read-only memory mapped file
+
+class MappedFile {
+
+	public:
+
+		MappedFile() {}
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const string& path);
+		void close();
+
+		bool isOpen() const { return data != nullptr; }
+		const uint8_t* getData() const { return data; }
+		size_t size() const { return length; }
+
+	protected:
+
+		const uint8_t* data = nullptr;
+		size_t length = 0;
+
+#ifdef TARGET_WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+#endif
+};
@@ -0,0 +1,145 @@
+#include "PairLoader.h"
+#include "Parallel.h"
+#include "Profiler.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+//--------------------------------------------------------------
+PairLoader::~PairLoader()
+{
+	stop();
+}
+
+//--------------------------------------------------------------
+bool PairLoader::start(const string& dirLeft, const string& dirRight, const CameraCalibration& left, const CameraCalibration& right, const CaptureStore& store)
+{
+	stop();
+
+	// index -> path per side
+
+	map<int, string> paths[2];
+	string dirs[2] = { dirLeft, dirRight };
+	for (int i = 0; i < 2; i++) {
+		ofDirectory dir;
+		dir.allowExt("jpg");
+		dir.allowExt("png");
+		dir.allowExt("ppm");
+		dir.allowExt("pgm");
+		dir.listDir(dirs[i]);
+		for (auto& file : dir) {
+			int index = getIndex(file.getFileName());
+			if (index < 0) {
+				ofLogWarning("PairLoader") << "no index number in " << file.getFileName() << ", skipping";
+				continue;
+			}
+			paths[i][index] = file.getAbsolutePath();
+		}
+	}
+
+	files.clear();
+	maxIndex = -1;
+	for (auto& entry : paths[0]) {
+		auto match = paths[1].find(entry.first);
+		if (match == paths[1].end()) {
+			ofLogWarning("PairLoader") << "no right image for " << entry.second << ", skipping";
+			continue;
+		}
+		files.emplace_back(entry.second, match->second);
+		maxIndex = entry.first;
+	}
+
+	ofLogNotice("PairLoader") << "found " << paths[0].size() << " left, " << paths[1].size() << " right images, " << files.size() << " pairs";
+
+	nTotal = (int)files.size();
+	nDone = 0;
+	nFound = 0;
+	nQueued = 0;
+	if (files.empty()) return false;
+
+	cals[0] = left;
+	cals[1] = right;
+	this->store = &store;
+
+	startThread();
+	return true;
+}
+
+//--------------------------------------------------------------
+void PairLoader::stop()
+{
+	if (isThreadRunning()) {
+		stopThread();	// tasks not started yet are skipped
+	}
+	waitForThread(false);
+
+	CaptureStore::Pair pair;
+	while (results.tryReceive(pair)) {}	// discard anything not picked up
+	nQueued = 0;
+}
+
+//--------------------------------------------------------------
+bool PairLoader::poll(CaptureStore::Pair& pair)
+{
+	if (!results.tryReceive(pair)) return false;
+	nQueued--;
+	return true;
+}
+
+//--------------------------------------------------------------
+int PairLoader::getIndex(const string& fileName)
+{
+	string base = ofFilePath::removeExt(fileName);
+	size_t end = base.find_last_of("0123456789");
+	if (end == string::npos) return -1;
+	size_t begin = base.find_last_not_of("0123456789", end);
+	begin = begin == string::npos ? 0 : begin + 1;
+	return ofToInt(base.substr(begin, end - begin + 1));
+}
+
+//--------------------------------------------------------------
+void PairLoader::threadedFunction()
+{
+	uint64_t t0 = ofGetElapsedTimeMillis();
+
+	// one task per pair: decode both views, search them, keep only the compact data
+	parallelFor(0, (int)files.size(), [&](int k) {
+
+		if (!isThreadRunning()) return;
+
+		PROFILE_SCOPE("load pair");
+
+		CaptureStore::Pair pair;
+		pair.views[0].path = files[k].first;
+		pair.views[1].path = files[k].second;
+
+		bool bOk = true;
+		for (int side = 0; side < 2; side++) {
+			auto& view = pair.views[side];
+
+			ofPixels pix;
+			if (!ofLoadImage(pix, view.path)) {
+				ofLogError("PairLoader") << "error loading " << view.path;
+				bOk = false;
+				break;
+			}
+			view.imageSize = cv::Size(pix.getWidth(), pix.getHeight());
+			store->makeThumbnail(pix, view.thumb);
+
+			CameraCalibration cal = cals[side];	// own copy, findBoard() isn't thread safe
+			if (!cal.findBoardCoarseToFine(toCv(pix), view.corners) || (int)view.corners.size() != cal.getPatternSize().area()) {
+				view.corners.clear();
+			}
+		}
+
+		if (bOk) {
+			pair.bSearched = true;
+			if (!pair.views[0].corners.empty() && !pair.views[1].corners.empty()) nFound++;
+			nQueued++;	// before the send, so isLoading() never sees it drop to 0 with a pair in flight
+			results.send(std::move(pair));
+		}
+		nDone++;
+	});
+
+	ofLogNotice("PairLoader") << "loaded " << nDone << " of " << nTotal << " pairs in " << ofGetElapsedTimeMillis() - t0 << " ms, board in " << nFound;
+}
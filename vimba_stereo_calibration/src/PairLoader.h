@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "CameraCalibration.h"
+#include "CaptureStore.h"
+
+// loads calibration image pairs from disk in the background
+//	- left / right files are paired by the number in their name (L_12.jpg <-> R_12.png), not by sort order
+//	- pairs are decoded on a worker pool, each pair's board search starts as soon as it's decoded
+//	- finished pairs (corners + thumbnails, no full images) are handed back to the main thread through poll()
+
+class PairLoader : public ofThread {
+
+	public:
+
+		~PairLoader();
+
+		// copies pattern and search settings, thumbnails are made like the store's
+		// false if there's nothing to load
+		bool start(const string& dirLeft, const string& dirRight, const CameraCalibration& left, const CameraCalibration& right, const CaptureStore& store);
+		void stop();
+
+		// main thread: next finished pair, in completion order
+		bool poll(CaptureStore::Pair& pair);
+
+		// true until the last finished pair has been taken with poll()
+		bool isLoading() const { return isThreadRunning() || nQueued > 0; }
+		int getNumTotal() const { return nTotal; }
+		int getNumDone() const { return nDone; }
+		int getNumFound() const { return nFound; }	// pairs with the board found in both views
+		int getMaxIndex() const { return maxIndex; }	// highest file number paired, -1 if none
+
+		// trailing number in a file name ("L_12.jpg" -> 12), -1 if there's none
+		static int getIndex(const string& fileName);
+
+	protected:
+
+		void threadedFunction() override;
+
+		vector<pair<string, string>> files;		// paired paths, sorted by index
+		CameraCalibration cals[2];
+		const CaptureStore* store = nullptr;
+
+		ofThreadChannel<CaptureStore::Pair> results;
+
+		std::atomic<int> nTotal{ 0 }, nDone{ 0 }, nFound{ 0 };
+		std::atomic<int> nQueued{ 0 };	// sent, not polled yet
+		int maxIndex = -1;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ofxCv.h"
+
+// runs fn(i) for every i in [begin, end) on OpenCV's thread pool, one task per index
+// (cv::parallel_for_ only takes lambdas directly from OpenCV 3.3 on)
+
+template<typename Fn>
+void parallelFor(int begin, int end, Fn fn)
+{
+	struct Body : public cv::ParallelLoopBody {
+		Fn& fn;
+		Body(Fn& fn) : fn(fn) {}
+		void operator()(const cv::Range& range) const override {
+			for (int i = range.start; i < range.end; i++) {
+				fn(i);
+			}
+		}
+	};
+
+	if (end <= begin) return;
+	Body body(fn);
+	cv::parallel_for_(cv::Range(begin, end), body, end - begin);
+}
@@ -0,0 +1,176 @@
+#include "PointCloud.h"
+#include "Parallel.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+//--------------------------------------------------------------
+void PointCloud::setup(const Mat& Q, float voxelSize)
+{
+	Mat Q32;
+	Q.convertTo(Q32, CV_32F);
+	this->Q = Matx44f((float*)Q32.ptr());
+	this->voxelSize = voxelSize;
+}
+
+//--------------------------------------------------------------
+size_t PointCloud::compute(const Mat& disparity, cv::Rect roi, int minDisparity, const ofPixels* color, uint64_t timestamp)
+{
+	uint64_t t0 = ofGetElapsedTimeMicros();
+
+	this->timestamp = timestamp;
+	numPoints = 0;
+
+	roi &= Rect(0, 0, disparity.cols, disparity.rows);
+	if (roi.area() == 0 || disparity.type() != CV_16S) return 0;
+
+	if (points.size() < (size_t)roi.area()) {
+		points.resize(roi.area());
+	}
+
+	bool bColor = color && (int)color->getWidth() == disparity.cols && (int)color->getHeight() == disparity.rows;
+	int cn = bColor ? (int)color->getNumChannels() : 0;
+
+	// [X Y Z W]' = Q * [x y d 1]', per row: Q * [0 y 0 1]' + x * Q.col(0) + d * Q.col(2)
+	Vec4f c0(Q(0, 0), Q(1, 0), Q(2, 0), Q(3, 0));
+	Vec4f c2(Q(0, 2), Q(1, 2), Q(2, 2), Q(3, 2));
+	short invalid = short(minDisparity * 16);	// DepthMapper marks invalid pixels (minDisparity - 1) * 16
+
+	int numStrips = min(roi.height, max(1, getNumberOfCPUs()));
+	stripCounts.assign(numStrips, 0);
+	if (rows.size() < (size_t)numStrips * roi.width) {
+		rows.resize((size_t)numStrips * roi.width);
+	}
+
+	parallelFor(0, numStrips, [&](int k) {
+		int y0 = roi.y + roi.height * k / numStrips;
+		int y1 = roi.y + roi.height * (k + 1) / numStrips;
+		Point* out = points.data() + (size_t)(y0 - roi.y) * roi.width;	// strip's own region
+		Vec4f* xyz = rows.data() + (size_t)k * roi.width;
+		size_t n = 0;
+
+		for (int y = y0; y < y1; y++) {
+			Vec4f row(Q(0, 1) * y + Q(0, 3), Q(1, 1) * y + Q(1, 3), Q(2, 1) * y + Q(2, 3), Q(3, 1) * y + Q(3, 3));
+			const short* disp = disparity.ptr<short>(y) + roi.x;
+
+			// reproject the whole row, no branches
+			for (int i = 0; i < roi.width; i++) {
+				float x = float(roi.x + i);
+				float d = disp[i] * (1.f / 16);
+				float w = row[3] + x * c0[3] + d * c2[3];
+				float valid = (disp[i] >= invalid) & (w > 0) ? 1.f : 0.f;	// w <= 0: behind the camera / at infinity
+				float iw = valid / (w + (1.f - valid));
+				xyz[i][0] = (row[0] + x * c0[0] + d * c2[0]) * iw;
+				xyz[i][1] = (row[1] + x * c0[1] + d * c2[1]) * iw;
+				xyz[i][2] = (row[2] + x * c0[2] + d * c2[2]) * iw;
+				xyz[i][3] = valid;
+			}
+
+			// keep the valid ones
+			const uint8_t* rgb = bColor ? color->getData() + ((size_t)y * color->getWidth() + roi.x) * cn : nullptr;
+			for (int i = 0; i < roi.width; i++) {
+				if (xyz[i][3] == 0) continue;
+				Point& p = out[n++];
+				p.x = xyz[i][0];
+				p.y = xyz[i][1];
+				p.z = xyz[i][2];
+				if (cn >= 3) {
+					p.r = rgb[i * cn];
+					p.g = rgb[i * cn + 1];
+					p.b = rgb[i * cn + 2];
+				}
+				else {
+					p.r = p.g = p.b = cn == 1 ? rgb[i] : 255;
+				}
+				p.a = 255;
+			}
+		}
+		stripCounts[k] = n;
+	});
+
+	// close the gaps between strips
+	for (int k = 0; k < numStrips; k++) {
+		int y0 = roi.y + roi.height * k / numStrips;
+		const Point* src = points.data() + (size_t)(y0 - roi.y) * roi.width;
+		if (src != points.data() + numPoints) {
+			memmove(points.data() + numPoints, src, stripCounts[k] * sizeof(Point));
+		}
+		numPoints += stripCounts[k];
+	}
+
+	if (voxelSize > 0) {
+		decimate();
+	}
+
+	computeMs = (ofGetElapsedTimeMicros() - t0) / 1000.f;
+	return numPoints;
+}
+
+//--------------------------------------------------------------
+void PointCloud::decimate()
+{
+	// table at least twice the largest point count, power of two
+	size_t tableSize = 1;
+	int bits = 0;
+	while (tableSize < 2 * points.size()) {
+		tableSize <<= 1;
+		bits++;
+	}
+	if (voxels.size() != tableSize) {
+		voxels.assign(tableSize, Voxel{ 0, 0 });
+		frame = 0;
+	}
+	frame++;
+	if (frame == 0) {	// wrapped, stamps are ambiguous again
+		voxels.assign(tableSize, Voxel{ 0, 0 });
+		frame = 1;
+	}
+
+	float scale = 1.f / voxelSize;
+	size_t mask = tableSize - 1;
+	size_t n = 0;
+
+	for (size_t i = 0; i < numPoints; i++) {
+		const Point& p = points[i];
+
+		// 21 bits per axis
+		uint64_t ix = uint64_t(int64_t(floor(p.x * scale)) & 0x1FFFFF);
+		uint64_t iy = uint64_t(int64_t(floor(p.y * scale)) & 0x1FFFFF);
+		uint64_t iz = uint64_t(int64_t(floor(p.z * scale)) & 0x1FFFFF);
+		uint64_t key = ix | (iy << 21) | (iz << 42);
+
+		size_t slot = size_t((key * 0x9E3779B97F4A7C15ull) >> (64 - bits)) & mask;
+		while (voxels[slot].frame == frame && voxels[slot].key != key) {
+			slot = (slot + 1) & mask;
+		}
+		if (voxels[slot].frame == frame) continue;	// voxel already has a point
+
+		voxels[slot].key = key;
+		voxels[slot].frame = frame;
+		points[n++] = p;
+	}
+	numPoints = n;
+}
+
+//--------------------------------------------------------------
+bool PointCloud::savePly(const string& path) const
+{
+	ofDirectory::createDirectory(ofFilePath::getEnclosingDirectory(ofToDataPath(path, true)), false, true);
+	ofFile file(path, ofFile::WriteOnly, true);
+	if (!file.is_open()) {
+		ofLogError("PointCloud") << "can't write " << ofToDataPath(path, true);
+		return false;
+	}
+
+	file << "ply\n";
+	file << "format binary_little_endian 1.0\n";
+	file << "comment timestamp " << timestamp << "\n";
+	file << "element vertex " << numPoints << "\n";
+	file << "property float x\nproperty float y\nproperty float z\n";
+	file << "property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n";
+	file << "end_header\n";
+	file.write((const char*)points.data(), numPoints * sizeof(Point));	// struct is packed as the header says, x86 is little endian
+
+	ofLogNotice("PointCloud") << "saved " << numPoints << " points to " << path;
+	return file.good();
+}
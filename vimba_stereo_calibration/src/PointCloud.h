@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+// 3D points from a disparity map, reprojected through Q
+//	- rows are reprojected in parallel strips, branch-free so the compiler can vectorize,
+//	  then invalid disparities are dropped
+//	- optional voxel grid decimation keeps the first point per voxel
+//	- buffers grow to the largest frame seen and are reused, nothing is allocated per frame after that
+
+class PointCloud {
+
+	public:
+
+		struct Point {
+			float x, y, z;
+			uint8_t r, g, b, a;
+		};
+
+		// Q from cv::stereoRectify, voxelSize in calibration units (0 = no decimation)
+		void setup(const cv::Mat& Q, float voxelSize = 0);
+
+		// disparity as from DepthMapper (CV_16S, disparity * 16), colour optional (same size, 1, 3 or 4 channels)
+		// minDisparity: disparities below are invalid
+		size_t compute(const cv::Mat& disparity, cv::Rect roi, int minDisparity, const ofPixels* color, uint64_t timestamp);
+
+		const Point* getPoints() const { return points.data(); }
+		size_t size() const { return numPoints; }
+		uint64_t getTimestamp() const { return timestamp; }
+		float getComputeMs() const { return computeMs; }
+
+		void setVoxelSize(float size) { voxelSize = size; }
+		float getVoxelSize() const { return voxelSize; }
+
+		// binary little endian PLY: x, y, z float + red, green, blue, alpha uchar
+		bool savePly(const string& path) const;
+
+	protected:
+
+		void decimate();
+
+		cv::Matx44f Q;
+		float voxelSize = 0;
+
+		vector<Point> points;		// capacity = ROI area
+		vector<cv::Vec4f> rows;		// one row of X, Y, Z, valid per strip
+		vector<size_t> stripCounts;
+		size_t numPoints = 0;
+		uint64_t timestamp = 0;
+		float computeMs = 0;
+
+		// voxel hash table, open addressing, entries stamped with the frame they were set in so it never needs clearing
+		struct Voxel {
+			uint64_t key;
+			uint32_t frame;
+		};
+		vector<Voxel> voxels;
+		uint32_t frame = 0;
+};
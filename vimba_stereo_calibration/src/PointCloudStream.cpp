@@ -0,0 +1,104 @@
+#include "PointCloudStream.h"
+
+//--------------------------------------------------------------
+PointCloudStream::~PointCloudStream()
+{
+	close();
+}
+
+//--------------------------------------------------------------
+bool PointCloudStream::open(const string& path, size_t ringSize)
+{
+	close();
+
+	string fullPath = ofToDataPath(path, true);
+	ofDirectory::createDirectory(ofFilePath::getEnclosingDirectory(fullPath), false, true);
+	file = fopen(fullPath.c_str(), "wb");
+	if (!file) {
+		ofLogError("PointCloudStream") << "can't write " << fullPath;
+		return false;
+	}
+
+	const char magic[8] = { 'P', 'C', 'L', 'D', 'S', 'T', 'R', 'M' };
+	uint32_t header[2] = { 1, sizeof(PointCloud::Point) };
+	fwrite(magic, 1, sizeof(magic), file);
+	fwrite(header, sizeof(header), 1, file);
+
+	ring.allocate(ringSize);
+	nWritten = 0;
+	nDropped = 0;
+	nBytes = sizeof(magic) + sizeof(header);
+
+	startThread();
+	ofLogNotice("PointCloudStream") << "recording point clouds to " << fullPath;
+	return true;
+}
+
+//--------------------------------------------------------------
+void PointCloudStream::close()
+{
+	if (isThreadRunning()) {
+		stopThread();
+		waitForThread(false);
+	}
+	if (file) {
+		// whatever the thread didn't get to
+		while (Frame* frame = ring.front()) {
+			writeFrame(*frame);
+			ring.pop();
+		}
+		fclose(file);
+		file = nullptr;
+		ofLogNotice("PointCloudStream") << "wrote " << nWritten << " frames, " << nBytes / (1024 * 1024) << " MB, dropped " << nDropped;
+	}
+}
+
+//--------------------------------------------------------------
+bool PointCloudStream::push(const PointCloud& cloud)
+{
+	if (!isThreadRunning()) return false;
+
+	Frame* frame = ring.beginWrite();
+	if (!frame) {
+		nDropped++;	// writer is behind
+		return false;
+	}
+	if (frame->points.size() < cloud.size()) {
+		frame->points.resize(cloud.size());
+	}
+	memcpy(frame->points.data(), cloud.getPoints(), cloud.size() * sizeof(PointCloud::Point));
+	frame->size = cloud.size();
+	frame->timestamp = cloud.getTimestamp();
+	ring.endWrite();
+	return true;
+}
+
+//--------------------------------------------------------------
+void PointCloudStream::threadedFunction()
+{
+	while (isThreadRunning()) {
+		Frame* frame = ring.front();
+		if (!frame) {
+			sleep(1);
+			continue;
+		}
+		writeFrame(*frame);
+		ring.pop();
+	}
+}
+
+//--------------------------------------------------------------
+bool PointCloudStream::writeFrame(const Frame& frame)
+{
+	uint64_t header[2] = { frame.timestamp, frame.size };
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1
+		&& fwrite(frame.points.data(), sizeof(PointCloud::Point), frame.size, file) == frame.size;
+	if (ok) {
+		nWritten++;
+		nBytes += sizeof(header) + frame.size * sizeof(PointCloud::Point);
+	}
+	else {
+		ofLogError("PointCloudStream") << "write error";
+	}
+	return ok;
+}
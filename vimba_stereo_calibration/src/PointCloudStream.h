@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ofMain.h"
+#include "PointCloud.h"
+#include "SpscRing.h"
+
+// records point cloud frames to a binary file on a background thread
+//	- push() copies the frame into a preallocated ring slot, frames are dropped (and counted) while the ring is full
+//	- file: "PCLDSTRM", uint32 version, uint32 bytes per point,
+//	  then per frame: uint64 timestamp (us), uint64 point count, points (PointCloud::Point, 16 bytes)
+
+class PointCloudStream : public ofThread {
+
+	public:
+
+		~PointCloudStream();
+
+		bool open(const string& path, size_t ringSize = 4);
+		void close();	// writes what's still queued
+		bool isOpen() const { return isThreadRunning(); }
+
+		// main thread
+		bool push(const PointCloud& cloud);
+
+		uint64_t getNumWritten() const { return nWritten; }
+		uint64_t getNumDropped() const { return nDropped; }
+		uint64_t getBytesWritten() const { return nBytes; }
+
+	protected:
+
+		struct Frame {
+			uint64_t timestamp = 0;
+			vector<PointCloud::Point> points;	// grows to the largest frame, reused
+			size_t size = 0;
+		};
+
+		void threadedFunction() override;
+		bool writeFrame(const Frame& frame);
+
+		SpscRing<Frame> ring;
+		FILE* file = nullptr;
+
+		std::atomic<uint64_t> nWritten{ 0 }, nDropped{ 0 }, nBytes{ 0 };
+};
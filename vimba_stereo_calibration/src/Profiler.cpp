@@ -0,0 +1,269 @@
+#include "Profiler.h"
+
+//--------------------------------------------------------------
+Profiler& Profiler::get()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+//--------------------------------------------------------------
+Profiler::Profiler()
+	: events(new Event[MAX_EVENTS])
+	, epoch(std::chrono::steady_clock::now())
+{
+	for (auto& stage : stages) {
+		for (auto& bin : stage.bins) {
+			bin.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+//--------------------------------------------------------------
+int Profiler::getStage(const char* name)
+{
+	std::lock_guard<std::mutex> lock(registerMutex);
+
+	// call sites with the same name share a stage
+	int n = numStages.load(std::memory_order_relaxed);
+	for (int i = 0; i < n; i++) {
+		if (strcmp(stages[i].name, name) == 0) return i;
+	}
+	if (n == MAX_STAGES) {
+		ofLogError("Profiler") << "more than " << int(MAX_STAGES) << " stages, not timing " << name;
+		return -1;
+	}
+	stages[n].name = name;
+	numStages.store(n + 1, std::memory_order_release);
+	return n;
+}
+
+//--------------------------------------------------------------
+uint64_t Profiler::now() const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+//--------------------------------------------------------------
+void Profiler::record(int stage, uint64_t startUs, uint64_t endUs)
+{
+	if (stage < 0 || stage >= numStages.load(std::memory_order_acquire)) return;
+
+	Stage& s = stages[stage];
+	uint64_t us = endUs > startUs ? endUs - startUs : 0;
+
+	s.count.fetch_add(1, std::memory_order_relaxed);
+	s.totalUs.fetch_add(us, std::memory_order_relaxed);
+	s.lastUs.store(us, std::memory_order_relaxed);
+	uint64_t prevMax = s.maxUs.load(std::memory_order_relaxed);
+	while (us > prevMax && !s.maxUs.compare_exchange_weak(prevMax, us, std::memory_order_relaxed)) {}
+	s.bins[getBin(us)].fetch_add(1, std::memory_order_relaxed);
+
+	// trace ring - seq is 0 while a slot is being written, readers skip it
+	uint64_t i = eventHead.fetch_add(1, std::memory_order_relaxed);
+	Event& e = events[i & (MAX_EVENTS - 1)];
+	e.seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	e.stageThread.store((uint64_t(stage) << 32) | getThreadId(), std::memory_order_relaxed);
+	e.start.store(startUs, std::memory_order_relaxed);
+	e.duration.store(us, std::memory_order_relaxed);
+	e.seq.store(i + 1, std::memory_order_release);
+}
+
+//--------------------------------------------------------------
+Profiler::Stats Profiler::getStats(int stage) const
+{
+	Stats stats;
+	if (stage < 0 || stage >= numStages.load(std::memory_order_acquire)) return stats;
+
+	const Stage& s = stages[stage];
+	stats.name = s.name;
+	stats.count = s.count.load(std::memory_order_relaxed);
+	if (stats.count == 0) return stats;
+
+	stats.lastMs = s.lastUs.load(std::memory_order_relaxed) / 1000.;
+	stats.meanMs = s.totalUs.load(std::memory_order_relaxed) / 1000. / stats.count;
+	stats.maxMs = s.maxUs.load(std::memory_order_relaxed) / 1000.;
+	stats.p50Ms = getPercentileMs(s, stats.count, 0.5);
+	stats.p90Ms = getPercentileMs(s, stats.count, 0.9);
+	stats.p99Ms = getPercentileMs(s, stats.count, 0.99);
+	return stats;
+}
+
+//--------------------------------------------------------------
+double Profiler::getPercentileMs(const Stage& stage, uint64_t count, double p) const
+{
+	// middle of the bin holding the rank, never above the max seen
+	uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(p * count));
+	uint64_t sum = 0;
+	double maxMs = stage.maxUs.load(std::memory_order_relaxed) / 1000.;
+	for (int b = 0; b < NUM_BINS; b++) {
+		sum += stage.bins[b].load(std::memory_order_relaxed);
+		if (sum >= rank) {
+			return std::min(maxMs, (getBinLower(b) + getBinUpper(b)) / 2000.);
+		}
+	}
+	return maxMs;	// counts moved on while reading
+}
+
+//--------------------------------------------------------------
+string Profiler::getHistogramString(int stage, int firstOctave, int numOctaves) const
+{
+	if (stage < 0 || stage >= numStages.load(std::memory_order_acquire)) return "";
+
+	// bins per octave of us, everything outside the range goes to the first / last
+	vector<uint64_t> octaves(numOctaves, 0);
+	uint64_t peak = 0;
+	for (int b = 0; b < NUM_BINS; b++) {
+		uint64_t n = stages[stage].bins[b].load(std::memory_order_relaxed);
+		if (!n) continue;
+		uint64_t lower = getBinLower(b);
+		int octave = 0;
+		while (lower >> (octave + 1)) octave++;
+		int k = ofClamp(octave - firstOctave, 0, numOctaves - 1);
+		octaves[k] += n;
+		peak = max(peak, octaves[k]);
+	}
+
+	const char levels[] = " .:-=+*#";
+	string hist;
+	for (auto n : octaves) {
+		hist += levels[peak ? (n * 7 + peak - 1) / peak : 0];
+	}
+	return hist;
+}
+
+//--------------------------------------------------------------
+string Profiler::getSummary() const
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(2);
+	ss << std::left << std::setw(22) << "stage (ms)" << std::right
+		<< std::setw(8) << "n" << std::setw(8) << "last" << std::setw(8) << "p50" << std::setw(8) << "p90"
+		<< std::setw(8) << "p99" << std::setw(8) << "max" << "  64us..262ms";
+
+	int n = numStages.load(std::memory_order_acquire);
+	for (int i = 0; i < n; i++) {
+		Stats s = getStats(i);
+		ss << "\n" << std::left << std::setw(22) << s.name.substr(0, 21) << std::right
+			<< std::setw(8) << s.count << std::setw(8) << s.lastMs << std::setw(8) << s.p50Ms << std::setw(8) << s.p90Ms
+			<< std::setw(8) << s.p99Ms << std::setw(8) << s.maxMs << "  |" << getHistogramString(i) << "|";
+	}
+	return ss.str();
+}
+
+//--------------------------------------------------------------
+bool Profiler::saveCsv(const string& path) const
+{
+	ofDirectory::createDirectory(ofFilePath::getEnclosingDirectory(path, false), false, true);
+	ofstream file(path, std::ios::binary);
+	if (!file) {
+		ofLogError("Profiler") << "can't write " << path;
+		return false;
+	}
+
+	file << "stage,count,mean_ms,p50_ms,p90_ms,p99_ms,max_ms";
+	for (int b = 0; b < NUM_BINS; b++) {
+		file << ",lt_" << getBinUpper(b) << "us";
+	}
+	file << "\n";
+
+	int n = numStages.load(std::memory_order_acquire);
+	for (int i = 0; i < n; i++) {
+		Stats s = getStats(i);
+		file << s.name << "," << s.count << "," << s.meanMs << "," << s.p50Ms << "," << s.p90Ms << "," << s.p99Ms << "," << s.maxMs;
+		for (int b = 0; b < NUM_BINS; b++) {
+			file << "," << stages[i].bins[b].load(std::memory_order_relaxed);
+		}
+		file << "\n";
+	}
+	return (bool)file;
+}
+
+//--------------------------------------------------------------
+bool Profiler::saveTrace(const string& path) const
+{
+	ofDirectory::createDirectory(ofFilePath::getEnclosingDirectory(path, false), false, true);
+	ofstream file(path, std::ios::binary);
+	if (!file) {
+		ofLogError("Profiler") << "can't write " << path;
+		return false;
+	}
+
+	// complete ("X") events, timestamps in us
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	uint64_t head = eventHead.load(std::memory_order_acquire);
+	uint64_t first = head > MAX_EVENTS ? head - MAX_EVENTS : 0;
+	bool bFirst = true;
+	for (uint64_t i = first; i < head; i++) {
+		const Event& e = events[i & (MAX_EVENTS - 1)];
+		uint64_t seq = e.seq.load(std::memory_order_acquire);
+		uint64_t stageThread = e.stageThread.load(std::memory_order_relaxed);
+		uint64_t start = e.start.load(std::memory_order_relaxed);
+		uint64_t duration = e.duration.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seq != i + 1 || e.seq.load(std::memory_order_relaxed) != seq) continue;	// being (over)written
+
+		file << (bFirst ? "\n" : ",\n") << "{\"name\":\"" << stages[stageThread >> 32].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (stageThread & 0xffffffff)
+			<< ",\"ts\":" << start << ",\"dur\":" << duration << "}";
+		bFirst = false;
+	}
+	file << "\n]}\n";
+	return (bool)file;
+}
+
+//--------------------------------------------------------------
+void Profiler::reset()
+{
+	int n = numStages.load(std::memory_order_acquire);
+	for (int i = 0; i < n; i++) {
+		Stage& s = stages[i];
+		s.count.store(0, std::memory_order_relaxed);
+		s.totalUs.store(0, std::memory_order_relaxed);
+		s.maxUs.store(0, std::memory_order_relaxed);
+		s.lastUs.store(0, std::memory_order_relaxed);
+		for (auto& bin : s.bins) {
+			bin.store(0, std::memory_order_relaxed);
+		}
+	}
+	for (size_t i = 0; i < MAX_EVENTS; i++) {
+		events[i].seq.store(0, std::memory_order_relaxed);
+	}
+}
+
+//--------------------------------------------------------------
+int Profiler::getBin(uint64_t us)
+{
+	// exact below 4 us, then 4 bins per octave
+	if (us < 4) return (int)us;
+	int e = 2;
+	while (us >> (e + 1)) e++;
+	int bin = (e - 1) * 4 + (int)((us >> (e - 2)) & 3);
+	return std::min(bin, NUM_BINS - 1);
+}
+
+//--------------------------------------------------------------
+uint64_t Profiler::getBinLower(int bin)
+{
+	if (bin < 4) return bin;
+	int e = bin / 4 + 1;
+	return uint64_t(4 + bin % 4) << (e - 2);
+}
+
+//--------------------------------------------------------------
+uint64_t Profiler::getBinUpper(int bin)
+{
+	if (bin < 4) return bin + 1;
+	int e = bin / 4 + 1;
+	return getBinLower(bin) + (uint64_t(1) << (e - 2));
+}
+
+//--------------------------------------------------------------
+uint32_t Profiler::getThreadId()
+{
+	// small sequential ids for the trace viewer
+	static std::atomic<uint32_t> nextId{ 1 };
+	thread_local uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+	return id;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "ofMain.h"
+
+// scoped stage timers feeding per-stage latency histograms
+//	- PROFILE_SCOPE("name") times the rest of the enclosing scope, on any thread
+//	- recording is lock-free: relaxed atomic counters + log-linear histogram bins (4 per octave of us)
+//	  and a fixed ring of the most recent events for trace export
+//	- stages are registered once per call site (a mutex, only on first use)
+//	- build with PROFILING=0 to compile the macros (and the app's overlay / export) out
+
+#ifndef PROFILING
+#define PROFILING 1
+#endif
+
+class Profiler {
+
+	public:
+
+		static const int MAX_STAGES = 64;
+		static const int NUM_BINS = 160;			// up to ~2^40 us
+		static const size_t MAX_EVENTS = 1 << 16;	// trace ring, oldest are overwritten
+
+		struct Stats {
+			string name;
+			uint64_t count = 0;
+			double lastMs = 0, meanMs = 0, p50Ms = 0, p90Ms = 0, p99Ms = 0, maxMs = 0;
+		};
+
+		static Profiler& get();
+
+		// index of a named stage, registered on first use, -1 if MAX_STAGES are taken
+		// name has to outlive the profiler (string literals)
+		int getStage(const char* name);
+
+		// us since the profiler was created
+		uint64_t now() const;
+
+		// lock-free, from any thread
+		void record(int stage, uint64_t startUs, uint64_t endUs);
+
+		size_t getNumStages() const { return numStages; }
+		Stats getStats(int stage) const;
+
+		// histogram bins coarsened to octaves, first bin from 2^firstOctave us, e.g. " .:=#  "
+		string getHistogramString(int stage, int firstOctave = 6, int numOctaves = 12) const;
+
+		// one line per stage, for the overlay
+		string getSummary() const;
+
+		// name, count, mean / percentiles / max in ms, then the raw bin counts with their upper bounds in us
+		bool saveCsv(const string& path) const;
+		// Chrome trace event format (chrome://tracing, Perfetto) of the events still in the ring
+		bool saveTrace(const string& path) const;
+
+		// clears counts, histograms and events, stages stay registered
+		void reset();
+
+		// bin <-> us
+		static int getBin(uint64_t us);
+		static uint64_t getBinLower(int bin);
+		static uint64_t getBinUpper(int bin);
+
+	protected:
+
+		Profiler();
+
+		struct Stage {
+			const char* name = nullptr;
+			std::atomic<uint64_t> count{ 0 }, totalUs{ 0 }, maxUs{ 0 }, lastUs{ 0 };
+			std::atomic<uint32_t> bins[NUM_BINS];
+		};
+
+		struct Event {
+			std::atomic<uint64_t> seq{ 0 };		// index + 1 once written
+			std::atomic<uint64_t> stageThread{ 0 }, start{ 0 }, duration{ 0 };
+		};
+
+		double getPercentileMs(const Stage& stage, uint64_t count, double p) const;
+		static uint32_t getThreadId();
+
+		Stage stages[MAX_STAGES];
+		std::atomic<int> numStages{ 0 };
+		std::mutex registerMutex;
+
+		unique_ptr<Event[]> events;
+		std::atomic<uint64_t> eventHead{ 0 };
+
+		std::chrono::steady_clock::time_point epoch;
+};
+
+// times its own lifetime into a stage
+class ScopedTimer {
+
+	public:
+
+		ScopedTimer(int stage) : stage(stage), start(Profiler::get().now()) {}
+		~ScopedTimer() { Profiler::get().record(stage, start, Profiler::get().now()); }
+
+	protected:
+
+		int stage;
+		uint64_t start;
+};
+
+#if PROFILING
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) \
+	static const int PROFILE_CONCAT(profileStage, __LINE__) = Profiler::get().getStage(name); \
+	ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)(PROFILE_CONCAT(profileStage, __LINE__))
+#else
+#define PROFILE_SCOPE(name)
+#endif
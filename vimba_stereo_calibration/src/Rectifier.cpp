@@ -0,0 +1,103 @@
+#include "Rectifier.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+//--------------------------------------------------------------
+void Rectifier::setup(const Mat& K, const Mat& D, const Mat& R, const Mat& P, cv::Size imageSize, int nClockwiseRotations)
+{
+	size = imageSize;
+	rotation = ((nClockwiseRotations % 4) + 4) % 4;
+
+	// map from output pixels to rotated image coords
+
+	Mat map;
+	initUndistortRectifyMap(K, D, R, P, size, CV_32FC2, map);
+
+	// fold the rotation in: rotated image coords -> raw frame coords
+
+	float w = size.width - 1;
+	float h = size.height - 1;
+
+	for (int y = 0; y < map.rows; y++) {
+		Vec2f* row = map.ptr<Vec2f>(y);
+		for (int x = 0; x < map.cols; x++) {
+			Vec2f& pt = row[x];
+			float rx = pt[0], ry = pt[1];
+			switch (rotation) {
+				case 1: pt = Vec2f(ry, w - rx); break;		// raw was turned clockwise
+				case 2: pt = Vec2f(w - rx, h - ry); break;
+				case 3: pt = Vec2f(h - ry, rx); break;		// raw was turned counter-clockwise
+				default: break;
+			}
+		}
+	}
+
+	convertMaps(map, noArray(), map1, map2, CV_16SC2);
+}
+
+//--------------------------------------------------------------
+void Rectifier::setup(const Mat& map1, const Mat& map2, int nClockwiseRotations)
+{
+	if (map1.type() != CV_16SC2 || map2.type() != CV_16UC1 || map1.size() != map2.size()) {
+		ofLogError("Rectifier") << "setup() expects CV_16SC2 + CV_16UC1 maps of equal size";
+		clear();
+		return;
+	}
+	this->map1 = map1;
+	this->map2 = map2;
+	size = map1.size();
+	rotation = ((nClockwiseRotations % 4) + 4) % 4;
+}
+
+//--------------------------------------------------------------
+void Rectifier::clear()
+{
+	map1.release();
+	map2.release();
+}
+
+//--------------------------------------------------------------
+void Rectifier::rectify(const ofPixels& raw, ofPixels& dst, int interpolation) const
+{
+	if (!isReady()) {
+		ofLogError("Rectifier") << "rectify() called before setup()";
+		return;
+	}
+
+	if (dst.getWidth() != size.width || dst.getHeight() != size.height || dst.getNumChannels() != raw.getNumChannels()) {
+		dst.allocate(size.width, size.height, raw.getNumChannels());
+	}
+
+	Mat src(raw.getHeight(), raw.getWidth(), CV_8UC(raw.getNumChannels()), (void*)raw.getData(), raw.getBytesStride());
+	Mat out = toCv(dst);
+	remap(src, out, map1, map2, interpolation);
+}
+
+//--------------------------------------------------------------
+int Rectifier::rectify(const ofPixels& raw, ofPixels& dst, cv::Rect roi, int interpolation) const
+{
+	if (!isReady()) {
+		ofLogError("Rectifier") << "rectify() called before setup()";
+		return 0;
+	}
+
+	roi &= Rect(Point(), size);
+	if (roi.area() == 0) return 0;
+
+	if (dst.getWidth() != size.width || dst.getHeight() != size.height || dst.getNumChannels() != raw.getNumChannels()) {
+		dst.allocate(size.width, size.height, raw.getNumChannels());
+	}
+
+	// map entries hold absolute source coords, so the map sub-rects remap straight into the output sub-rect
+	Mat src(raw.getHeight(), raw.getWidth(), CV_8UC(raw.getNumChannels()), (void*)raw.getData(), raw.getBytesStride());
+	Mat out = toCv(dst)(roi);
+	remap(src, out, map1(roi), map2.empty() ? map2 : map2(roi), interpolation);
+	return roi.area();
+}
+
+//--------------------------------------------------------------
+size_t Rectifier::getMapBytes() const
+{
+	return map1.total() * map1.elemSize() + map2.total() * map2.elemSize();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+// stereo rectification from raw (unrotated) camera frames in a single remap
+//	- the sensor rotation (ofPixels::rotate90 convention) is folded into the lookup table,
+//	  so frames don't need to be rotated first
+//	- maps are stored fixed-point: CV_16SC2 integer coords + CV_16UC1 interpolation table index
+
+class Rectifier {
+
+	public:
+
+		// K, D, R, P as used by cv::initUndistortRectifyMap
+		// imageSize is the calibrated (rotated) image size, i.e. the output size
+		void setup(const cv::Mat& K, const cv::Mat& D, const cv::Mat& R, const cv::Mat& P, cv::Size imageSize, int nClockwiseRotations = 0);
+		// precomputed maps (e.g. from a CalibrationBundle), not copied
+		void setup(const cv::Mat& map1, const cv::Mat& map2, int nClockwiseRotations);
+		void clear();
+
+		bool isReady() const { return !map1.empty(); }
+
+		// raw camera frame -> rectified, dst is allocated to the output size if needed
+		void rectify(const ofPixels& raw, ofPixels& dst, int interpolation = cv::INTER_LINEAR) const;
+		// only the roi (output coords) of dst, the rest is left as it was - same maps, no full frame work
+		// returns the number of pixels remapped
+		int rectify(const ofPixels& raw, ofPixels& dst, cv::Rect roi, int interpolation = cv::INTER_LINEAR) const;
+
+		cv::Size getSize() const { return size; }
+		int getRotation() const { return rotation; }
+		size_t getMapBytes() const;
+		const cv::Mat& getMap1() const { return map1; }
+		const cv::Mat& getMap2() const { return map2; }
+
+	protected:
+
+		cv::Mat map1, map2;
+		cv::Size size;
+		int rotation = 0;	// clockwise quarter turns, 0-3
+};
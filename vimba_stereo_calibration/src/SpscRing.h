@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+// lock-free single producer / single consumer ring of preallocated slots
+//	- producer: beginWrite() -> fill slot -> endWrite()
+//	- consumer: front() -> read / swap slot contents -> pop()
+// slots are reused in place, so whatever they own (e.g. pixel buffers) is recycled
+
+template<typename T>
+class SpscRing {
+
+	public:
+
+		SpscRing(size_t capacity = 4) { allocate(capacity); }
+
+		// not thread safe, call before producer / consumer start
+		void allocate(size_t capacity) {
+			slots.clear();
+			slots.resize(capacity + 1);	// one slot stays empty to tell full from empty
+			head = 0;
+			tail = 0;
+		}
+
+		// producer: next slot to fill, nullptr if the ring is full
+		T* beginWrite() {
+			size_t h = head.load(std::memory_order_relaxed);
+			if (next(h) == tail.load(std::memory_order_acquire)) return nullptr;
+			return &slots[h];
+		}
+		// producer: publish the slot from beginWrite()
+		void endWrite() {
+			head.store(next(head.load(std::memory_order_relaxed)), std::memory_order_release);
+		}
+
+		// consumer: oldest published slot, nullptr if the ring is empty
+		T* front() {
+			size_t t = tail.load(std::memory_order_relaxed);
+			if (t == head.load(std::memory_order_acquire)) return nullptr;
+			return &slots[t];
+		}
+		// consumer: hand the slot from front() back to the producer
+		void pop() {
+			tail.store(next(tail.load(std::memory_order_relaxed)), std::memory_order_release);
+		}
+
+		size_t capacity() const { return slots.size() - 1; }
+
+	protected:
+
+		size_t next(size_t i) const { return (i + 1) % slots.size(); }
+
+		std::vector<T> slots;
+		std::atomic<size_t> head{ 0 }, tail{ 0 };
+};
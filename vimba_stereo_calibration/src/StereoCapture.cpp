@@ -0,0 +1,131 @@
+#include "StereoCapture.h"
+
+//--------------------------------------------------------------
+StereoCapture::~StereoCapture()
+{
+	stop();
+}
+
+//--------------------------------------------------------------
+void StereoCapture::setup(CameraSource& cam0, CameraSource& cam1, size_t ringSize)
+{
+	stop();
+	threads[0].cam = &cam0;
+	threads[1].cam = &cam1;
+	for (auto& thread : threads) {
+		thread.pool = &pool;
+		thread.ring.allocate(ringSize);
+	}
+}
+
+//--------------------------------------------------------------
+void StereoCapture::start()
+{
+	for (auto& thread : threads) {
+		if (thread.cam && !thread.isThreadRunning()) {
+			thread.startThread();
+		}
+	}
+}
+
+//--------------------------------------------------------------
+void StereoCapture::stop()
+{
+	for (auto& thread : threads) {
+		if (thread.isThreadRunning()) {
+			thread.waitForThread(true);
+		}
+	}
+}
+
+//--------------------------------------------------------------
+bool StereoCapture::update()
+{
+	// take everything the capture threads have published
+
+	for (int i = 0; i < 2; i++) {
+		auto& ring = threads[i].ring;
+		while (Frame* slot = ring.front()) {
+			pending[i].push_back(std::move(*slot));
+			ring.pop();
+		}
+	}
+
+	// pair oldest first, keep the newest pair
+
+	bFrameNew = false;
+
+	while (!pending[0].empty() && !pending[1].empty()) {
+		Frame& l = pending[0].front();
+		Frame& r = pending[1].front();
+		int64_t dt = int64_t(l.timestamp) - int64_t(r.timestamp);
+
+		if (uint64_t(std::abs(dt)) <= maxSkew) {
+			if (bFrameNew) nLate++;
+			current[0] = std::move(l);	// previous pair goes back to the pool
+			current[1] = std::move(r);
+			pending[0].pop_front();
+			pending[1].pop_front();
+			nPaired++;
+			nUnpairedRun = 0;
+			bFrameNew = true;
+		}
+		else {
+			// the older frame can't be paired anymore
+			int i = dt < 0 ? 0 : 1;
+			pending[i].pop_front();
+			nUnpaired++;
+
+			// free running cameras keep their phase, a tolerance under it pairs nothing at all
+			if (++nUnpairedRun == UNPAIRED_WARNING) {
+				ofLogWarning("StereoCapture") << uint64_t(UNPAIRED_WARNING) << " frames in a row without a partner, the cameras are " << std::abs(dt) / 1000.f
+					<< " ms apart, tolerance " << maxSkew / 1000.f << " ms - trigger them together or raise the tolerance";
+			}
+		}
+	}
+
+	// a stalled camera shouldn't make the other side's frames pile up
+
+	for (int i = 0; i < 2; i++) {
+		while (pending[i].size() > threads[i].ring.capacity()) {
+			pending[i].pop_front();
+			nUnpaired++;
+		}
+	}
+
+	return bFrameNew;
+}
+
+//--------------------------------------------------------------
+void StereoCapture::CaptureThread::threadedFunction()
+{
+	while (isThreadRunning()) {
+
+		cam->update();
+
+		if (!cam->isFrameNew()) {
+			sleep(1);
+			continue;
+		}
+
+		uint64_t timestamp = cam->getTimestamp();
+		push(timestamp ? timestamp : ofGetElapsedTimeMicros());
+	}
+}
+
+//--------------------------------------------------------------
+void StereoCapture::CaptureThread::push(uint64_t timestamp)
+{
+	Frame* slot = ring.beginWrite();
+	if (!slot) {
+		nDropped++;
+		return;
+	}
+
+	// the camera reuses its buffer, so this is the one copy a frame gets
+	const ofPixels& src = cam->getFrame();
+	slot->pix = pool->acquire(src.getWidth(), src.getHeight(), src.getNumChannels());
+	memcpy(slot->pix->getData(), src.getData(), src.getTotalBytes());
+	slot->timestamp = timestamp;
+	ring.endWrite();
+}
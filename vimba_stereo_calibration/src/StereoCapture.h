@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ofMain.h"
+#include "CameraSource.h"
+#include "SpscRing.h"
+#include "FramePool.h"
+
+// stereo capture with one thread per camera
+//	- each capture thread polls its camera, copies new frames into a pooled buffer (the only copy)
+//	  and pushes them into a lock-free SPSC ring
+//	- update() (main thread) pairs left / right frames whose timestamps are within the skew tolerance,
+//	  frames without a partner are dropped
+//	- timestamps are the source's capture times if it has them, host arrival times (ofGetElapsedTimeMicros) otherwise;
+//	  both sides have to be on the same clock, the skew tolerance is compared against their difference
+
+class StereoCapture {
+
+	public:
+
+		struct Frame {
+			FramePool::Ref pix;
+			uint64_t timestamp = 0;	// usec
+		};
+
+		~StereoCapture();
+
+		void setup(CameraSource& cam0, CameraSource& cam1, size_t ringSize = 4);
+		void start();
+		void stop();
+
+		void setMaxSkew(uint64_t usec) { maxSkew = usec; }
+		uint64_t getMaxSkew() const { return maxSkew; }
+
+		// main thread: pair up frames from the capture threads, true if there's a new stereo pair
+		bool update();
+		bool isFrameNew() const { return bFrameNew; }
+
+		// newest stereo pair, raw camera orientation
+		const ofPixels& getFrame(int i) const { return *current[i].pix; }
+		const FramePool::Ref& getFrameRef(int i) const { return current[i].pix; }
+		uint64_t getTimestamp(int i) const { return current[i].timestamp; }
+		int64_t getSkew() const { return int64_t(current[0].timestamp) - int64_t(current[1].timestamp); }
+
+		// counters
+		uint64_t getNumPaired() const { return nPaired; }
+		uint64_t getNumDropped(int i) const { return threads[i].nDropped; }	// ring full, consumer too slow
+		uint64_t getNumLate() const { return nLate; }			// paired, but superseded by a newer pair before update() handed it out
+		uint64_t getNumUnpaired() const { return nUnpaired; }	// no partner within the skew tolerance
+		uint64_t getNumAllocations() const { return pool.getNumAllocations(); }	// frame buffers, flat in steady state
+
+	protected:
+
+		class CaptureThread : public ofThread {
+			public:
+				CameraSource* cam = nullptr;
+				FramePool* pool = nullptr;
+				SpscRing<Frame> ring;
+				std::atomic<uint64_t> nDropped{ 0 };
+
+			protected:
+				void threadedFunction() override;
+				void push(uint64_t timestamp);
+		};
+
+		FramePool pool;		// declared first, outlives the frames below
+		CaptureThread threads[2];
+
+		deque<Frame> pending[2];	// taken from the rings, waiting for a partner
+		Frame current[2];
+
+		uint64_t maxSkew = 5000;
+		bool bFrameNew = false;
+		uint64_t nPaired = 0, nLate = 0, nUnpaired = 0;
+		uint64_t nUnpairedRun = 0;	// since the last pair, warns at UNPAIRED_WARNING
+		static const uint64_t UNPAIRED_WARNING = 100;
+};
@@ -0,0 +1,228 @@
+#include "StereoRecorder.h"
+#include "Profiler.h"
+
+const char StereoRecorder::FILE_MAGIC[8] = { 'S', 'T', 'E', 'R', 'E', 'C', 'R', 'W' };
+const char StereoRecorder::PAIR_MAGIC[4] = { 'P', 'A', 'I', 'R' };
+const char StereoRecorder::INDEX_MAGIC[4] = { 'I', 'N', 'D', 'X' };
+
+namespace {
+
+	uint64_t align(uint64_t n, uint64_t alignment) {
+		return (n + alignment - 1) / alignment * alignment;
+	}
+
+	uint64_t getFrameBytes(const StereoRecorder::FileHeader& header, int i) {
+		return uint64_t(header.width[i]) * header.height[i] * header.channels[i];
+	}
+}
+
+//--------------------------------------------------------------
+uint64_t StereoRecorder::getFrameOffset(const FileHeader& header, int i)
+{
+	uint64_t offset = align(sizeof(PairHeader), FRAME_ALIGN);
+	return i == 0 ? offset : offset + align(getFrameBytes(header, 0), FRAME_ALIGN);
+}
+
+//--------------------------------------------------------------
+uint64_t StereoRecorder::getPairBytes(const FileHeader& header)
+{
+	return align(getFrameOffset(header, 1) + getFrameBytes(header, 1), RECORD_ALIGN);
+}
+
+//--------------------------------------------------------------
+uint64_t StereoRecorder::getIndexBytes(const FileHeader& header)
+{
+	return align(sizeof(ChunkIndex) + header.framesPerChunk * sizeof(uint64_t), RECORD_ALIGN);
+}
+
+//--------------------------------------------------------------
+uint64_t StereoRecorder::getPairOffset(const FileHeader& header, uint64_t n)
+{
+	return HEADER_BYTES + (n / header.framesPerChunk) * getChunkBytes(header) + (n % header.framesPerChunk) * header.pairBytes;
+}
+
+//--------------------------------------------------------------
+StereoRecorder::~StereoRecorder()
+{
+	stop();
+}
+
+//--------------------------------------------------------------
+bool StereoRecorder::start(const string& path, const ofPixels& frame0, const ofPixels& frame1, int nClockwiseRotations, size_t maxQueued)
+{
+	stop();
+
+	if (!frame0.isAllocated() || !frame1.isAllocated()) {
+		ofLogError("StereoRecorder") << "no frames to take the recording's size from";
+		return false;
+	}
+
+	ofDirectory::createDirectory(ofFilePath::getEnclosingDirectory(path, false), false, true);
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		ofLogError("StereoRecorder") << "can't write " << path;
+		return false;
+	}
+	this->path = path;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+	header.version = VERSION;
+	header.framesPerChunk = FRAMES_PER_CHUNK;
+	const ofPixels* frames[2] = { &frame0, &frame1 };
+	for (int i = 0; i < 2; i++) {
+		header.width[i] = (uint32_t)frames[i]->getWidth();
+		header.height[i] = (uint32_t)frames[i]->getHeight();
+		header.channels[i] = (uint32_t)frames[i]->getNumChannels();
+	}
+	header.rotation = nClockwiseRotations;
+	header.pairBytes = getPairBytes(header);
+	header.indexBytes = getIndexBytes(header);
+	header.startMicros = ofGetSystemTimeMicros();
+
+	nWritten = 0;
+	nDropped = 0;
+	nBytes = 0;
+	frameNum = 0;
+	chunkTimestamps.clear();
+	chunkTimestamps.reserve(FRAMES_PER_CHUNK);
+
+	if (!writePadded(&header, sizeof(header), HEADER_BYTES)) {
+		ofLogError("StereoRecorder") << "can't write " << path;
+		file.close();
+		return false;
+	}
+
+	this->maxQueued = max<size_t>(1, maxQueued);
+	bRunning = true;
+	worker = std::thread(&StereoRecorder::threadedFunction, this);
+
+	ofLogNotice("StereoRecorder") << "recording " << header.width[0] << "x" << header.height[0] << "x" << header.channels[0]
+		<< " pairs to " << path << " (" << header.pairBytes / 1024 << " KiB per pair)";
+	return true;
+}
+
+//--------------------------------------------------------------
+void StereoRecorder::stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!bRunning) return;
+		bRunning = false;	// the writer drains the queue before it exits
+	}
+	cond.notify_all();
+	worker.join();
+
+	// the last chunk stays without index, replay recovers it from the pair headers
+	file.close();
+	ofLogNotice("StereoRecorder") << "recorded " << nWritten << " pairs (" << nBytes / (1024 * 1024) << " MiB), dropped " << nDropped << " - " << path;
+}
+
+//--------------------------------------------------------------
+bool StereoRecorder::write(const FramePool::Ref& frame0, const FramePool::Ref& frame1, uint64_t timestamp0, uint64_t timestamp1)
+{
+	const FramePool::Ref* frames[2] = { &frame0, &frame1 };
+	for (int i = 0; i < 2; i++) {
+		const FramePool::Ref& f = *frames[i];
+		if (!f || f->getWidth() != header.width[i] || f->getHeight() != header.height[i] || f->getNumChannels() != header.channels[i]) {
+			nDropped++;
+			return false;
+		}
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!bRunning || queue.size() >= maxQueued) {
+			nDropped++;
+			return false;
+		}
+		queue.push_back(Pair{ { frame0, frame1 }, { timestamp0, timestamp1 } });
+	}
+	cond.notify_one();
+	return true;
+}
+
+//--------------------------------------------------------------
+void StereoRecorder::threadedFunction()
+{
+	bool bFailed = false;
+
+	while (true) {
+		Pair pair;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this] { return !queue.empty() || !bRunning; });
+			if (queue.empty()) return;	// stopped and drained
+			pair = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		if (bFailed) {
+			nDropped++;
+			continue;
+		}
+
+		PROFILE_SCOPE("record pair");
+		if (!writePair(pair) || (chunkTimestamps.size() == FRAMES_PER_CHUNK && !writeIndex())) {
+			ofLogError("StereoRecorder") << "write failed after " << nWritten << " pairs, recording stops here - " << path;
+			bFailed = true;
+			nDropped++;
+		}
+	}
+}
+
+//--------------------------------------------------------------
+bool StereoRecorder::writePair(const Pair& pair)
+{
+	PairHeader pairHeader;
+	memset(&pairHeader, 0, sizeof(pairHeader));
+	memcpy(pairHeader.magic, PAIR_MAGIC, sizeof(PAIR_MAGIC));
+	pairHeader.frameNum = frameNum;
+	pairHeader.timestamp[0] = pair.timestamps[0];
+	pairHeader.timestamp[1] = pair.timestamps[1];
+
+	uint64_t offset1 = getFrameOffset(header, 1);
+	const ofPixels& f0 = *pair.frames[0];
+	const ofPixels& f1 = *pair.frames[1];
+	if (!writePadded(&pairHeader, sizeof(pairHeader), getFrameOffset(header, 0))
+		|| !writePadded(f0.getData(), f0.getTotalBytes(), offset1 - getFrameOffset(header, 0))
+		|| !writePadded(f1.getData(), f1.getTotalBytes(), header.pairBytes - offset1)) {
+		return false;
+	}
+
+	chunkTimestamps.push_back(pair.timestamps[0]);
+	frameNum++;
+	nWritten++;
+	return true;
+}
+
+//--------------------------------------------------------------
+bool StereoRecorder::writeIndex()
+{
+	ChunkIndex index;
+	memset(&index, 0, sizeof(index));
+	memcpy(index.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	index.numFrames = (uint32_t)chunkTimestamps.size();
+	index.firstFrame = frameNum - chunkTimestamps.size();
+
+	bool bOk = writePadded(&index, sizeof(index), sizeof(index))
+		&& writePadded(chunkTimestamps.data(), chunkTimestamps.size() * sizeof(uint64_t), header.indexBytes - sizeof(index));
+	file.flush();	// a full chunk is on disk, replayable even if the app dies
+	chunkTimestamps.clear();
+	return bOk && (bool)file;
+}
+
+//--------------------------------------------------------------
+bool StereoRecorder::writePadded(const void* data, size_t bytes, size_t alignedBytes)
+{
+	static const char zeros[RECORD_ALIGN] = {};
+
+	file.write((const char*)data, bytes);
+	for (size_t padding = alignedBytes - bytes; padding > 0;) {
+		size_t n = min(padding, sizeof(zeros));
+		file.write(zeros, n);
+		padding -= n;
+	}
+	nBytes += alignedBytes;
+	return (bool)file;
+}
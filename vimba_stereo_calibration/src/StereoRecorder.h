@@ -0,0 +1,108 @@
+#pragma once
+
+#include "ofMain.h"
+#include "FramePool.h"
+
+// records raw stereo pairs (sensor orientation, before rotate90) to an append-only container on a writer thread
+//	- bounded queue, write() drops pairs while it's full so recording never stalls capture
+//	- stop() writes everything still queued before returning
+//	- see StereoReplay for reading recordings back
+//
+// container layout, little endian, all records fixed size so frame n is at a computable offset:
+//	- FileHeader, padded to HEADER_BYTES
+//	- chunks of FRAMES_PER_CHUNK pair records, each chunk followed by its ChunkIndex (left timestamps)
+//	- pair record: PairHeader, left frame, right frame, 64 byte aligned, padded to a multiple of 4 KiB
+//	- a recording cut short (crash, full disk) ends in a chunk without index, its pair headers still hold the timestamps
+
+class StereoRecorder {
+
+	public:
+
+		static const uint32_t VERSION = 1;
+		static const uint32_t FRAMES_PER_CHUNK = 256;
+		static const size_t HEADER_BYTES = 4096;
+		static const size_t RECORD_ALIGN = 4096;	// pair records and chunk indices
+		static const size_t FRAME_ALIGN = 64;		// frames inside a pair record
+
+		static const char FILE_MAGIC[8];
+		static const char PAIR_MAGIC[4];
+		static const char INDEX_MAGIC[4];
+
+		struct FileHeader {
+			char magic[8];
+			uint32_t version;
+			uint32_t framesPerChunk;
+			uint32_t width[2], height[2], channels[2];
+			int32_t rotation;			// clockwise quarter turns from the recorded frames to calibrated images
+			uint32_t reserved;
+			uint64_t pairBytes;			// size of a pair record
+			uint64_t indexBytes;		// size of a chunk index
+			uint64_t startMicros;		// system time the recording started (ofGetSystemTimeMicros)
+		};
+
+		struct PairHeader {
+			char magic[4];
+			uint32_t reserved;
+			uint64_t frameNum;
+			uint64_t timestamp[2];		// usec, as captured
+		};
+
+		struct ChunkIndex {
+			char magic[4];
+			uint32_t numFrames;
+			uint64_t firstFrame;
+			// followed by numFrames left timestamps (uint64_t)
+		};
+
+		// record sizes for a header's frame sizes
+		static uint64_t getFrameOffset(const FileHeader& header, int i);	// inside a pair record
+		static uint64_t getPairBytes(const FileHeader& header);
+		static uint64_t getIndexBytes(const FileHeader& header);
+		static uint64_t getChunkBytes(const FileHeader& header) { return header.framesPerChunk * header.pairBytes + header.indexBytes; }
+		static uint64_t getPairOffset(const FileHeader& header, uint64_t n);
+
+		~StereoRecorder();
+
+		// new recording at path, frame sizes / channels taken from the first pair
+		bool start(const string& path, const ofPixels& frame0, const ofPixels& frame1, int nClockwiseRotations, size_t maxQueued = 8);
+		void stop();
+
+		bool isRecording() const { return bRunning; }
+		const string& getPath() const { return path; }
+
+		// queue a pair, false if the queue is full, the sizes don't match the recording or it isn't running
+		bool write(const FramePool::Ref& frame0, const FramePool::Ref& frame1, uint64_t timestamp0, uint64_t timestamp1);
+
+		uint64_t getNumWritten() const { return nWritten; }
+		uint64_t getNumDropped() const { return nDropped; }
+		uint64_t getBytesWritten() const { return nBytes; }
+
+	protected:
+
+		struct Pair {
+			FramePool::Ref frames[2];
+			uint64_t timestamps[2];
+		};
+
+		void threadedFunction();
+		bool writePair(const Pair& pair);
+		bool writeIndex();
+		bool writePadded(const void* data, size_t bytes, size_t alignedBytes);
+
+		FileHeader header;
+		string path;
+		ofstream file;
+
+		std::mutex mutex;
+		std::condition_variable cond;
+		deque<Pair> queue;
+		std::thread worker;
+		size_t maxQueued = 8;
+		std::atomic<bool> bRunning{ false };
+
+		// writer thread only
+		uint64_t frameNum = 0;
+		vector<uint64_t> chunkTimestamps;
+
+		std::atomic<uint64_t> nWritten{ 0 }, nDropped{ 0 }, nBytes{ 0 };
+};
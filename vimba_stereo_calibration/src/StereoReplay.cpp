@@ -0,0 +1,276 @@
+#include "StereoReplay.h"
+
+//--------------------------------------------------------------
+bool StereoReplay::open(const string& path)
+{
+	close();
+
+	if (!file.open(path)) {
+		ofLogError("StereoReplay") << "can't open " << path;
+		return false;
+	}
+
+	const uint8_t* data = file.getData();
+	uint64_t size = file.size();
+
+	if (size < StereoRecorder::HEADER_BYTES) {
+		ofLogError("StereoReplay") << "not a stereo recording: " << path;
+		close();
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+
+	bool bValid = memcmp(header.magic, StereoRecorder::FILE_MAGIC, sizeof(StereoRecorder::FILE_MAGIC)) == 0
+		&& header.version == StereoRecorder::VERSION && header.framesPerChunk > 0;
+	for (int i = 0; i < 2 && bValid; i++) {
+		bValid = header.width[i] > 0 && header.height[i] > 0 && header.channels[i] >= 1 && header.channels[i] <= 4;
+	}
+	if (!bValid || header.pairBytes != StereoRecorder::getPairBytes(header) || header.indexBytes != StereoRecorder::getIndexBytes(header)) {
+		ofLogError("StereoReplay") << "not a stereo recording (or another version): " << path;
+		close();
+		return false;
+	}
+
+	// timestamps of the indexed chunks, then of whatever follows from its pair headers
+
+	uint64_t chunkBytes = StereoRecorder::getChunkBytes(header);
+	uint64_t nChunks = 0;
+	while (true) {
+		uint64_t indexOffset = StereoRecorder::HEADER_BYTES + nChunks * chunkBytes + header.framesPerChunk * header.pairBytes;
+		if (indexOffset + header.indexBytes > size) break;
+
+		StereoRecorder::ChunkIndex index;
+		memcpy(&index, data + indexOffset, sizeof(index));
+		if (memcmp(index.magic, StereoRecorder::INDEX_MAGIC, sizeof(StereoRecorder::INDEX_MAGIC)) != 0
+			|| index.numFrames != header.framesPerChunk || index.firstFrame != nChunks * header.framesPerChunk) break;
+
+		size_t first = timestamps.size();
+		timestamps.resize(first + index.numFrames);
+		memcpy(&timestamps[first], data + indexOffset + sizeof(index), index.numFrames * sizeof(uint64_t));
+		nChunks++;
+	}
+	for (uint64_t n = timestamps.size(); n < (nChunks + 1) * header.framesPerChunk; n++) {
+		uint64_t offset = StereoRecorder::getPairOffset(header, n);
+		if (offset + header.pairBytes > size) break;
+
+		StereoRecorder::PairHeader pair;
+		memcpy(&pair, data + offset, sizeof(pair));
+		if (memcmp(pair.magic, StereoRecorder::PAIR_MAGIC, sizeof(StereoRecorder::PAIR_MAGIC)) != 0 || pair.frameNum != n) break;
+		timestamps.push_back(pair.timestamp[0]);
+	}
+
+	if (timestamps.empty()) {
+		ofLogError("StereoReplay") << "no frames in " << path;
+		close();
+		return false;
+	}
+
+	// time lookup - needs timestamps that don't go back
+	uint64_t nBackwards = 0;
+	for (size_t n = 1; n < timestamps.size(); n++) {
+		if (timestamps[n] < timestamps[n - 1]) {
+			timestamps[n] = timestamps[n - 1];
+			nBackwards++;
+		}
+	}
+	if (nBackwards) {
+		ofLogWarning("StereoReplay") << nBackwards << " timestamps go back in time, seeking by time near them is approximate";
+	}
+
+	bucketMicros = max<uint64_t>(1, getDuration() / timestamps.size());
+	buckets.resize(getDuration() / bucketMicros + 1);
+	uint32_t n = 0;
+	for (size_t b = 0; b < buckets.size(); b++) {
+		uint64_t t = timestamps.front() + b * bucketMicros;
+		while (n < timestamps.size() && timestamps[n] < t) n++;
+		buckets[b] = n;
+	}
+
+	for (int i = 0; i < 2; i++) {
+		sources[i].replay = this;
+		sources[i].index = i;
+		sources[i].bFrameNew = false;
+	}
+	lastTimestamp = 0;
+	nUnmatched = 0;
+	playback = Playback();
+	seek(0);
+
+	ofLogNotice("StereoReplay") << path << " - " << timestamps.size() << " pairs of " << header.width[0] << "x" << header.height[0] << "x" << header.channels[0]
+		<< ", " << ofToString(getDuration() / 1e6, 1) << " sec" << (nChunks * header.framesPerChunk < timestamps.size() ? " (last chunk unindexed)" : "");
+	return true;
+}
+
+//--------------------------------------------------------------
+void StereoReplay::close()
+{
+	file.close();
+	timestamps.clear();
+	buckets.clear();
+	for (auto& source : sources) {
+		source.frame.clear();
+	}
+}
+
+//--------------------------------------------------------------
+void StereoReplay::setRealtime(bool bRealtime)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	this->bRealtime = bRealtime;
+
+	// the clock restarts from where playback is
+	playback.startFrame = min(getPosition(), max<uint64_t>(1, getNumFrames()) - 1);
+	playback.startMicros = ofGetElapsedTimeMicros();
+}
+
+//--------------------------------------------------------------
+uint64_t StereoReplay::getPosition() const
+{
+	return min(positions[0].load(), positions[1].load());
+}
+
+//--------------------------------------------------------------
+void StereoReplay::seek(uint64_t n)
+{
+	if (timestamps.empty()) return;
+	n = min<uint64_t>(n, timestamps.size() - 1);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	playback.startFrame = n;
+	playback.startMicros = ofGetElapsedTimeMicros();
+	playback.consumed = n;
+	playback.consumedMicros = playback.startMicros;
+
+	// replayed timestamps keep going forward
+	int64_t last = lastTimestamp;
+	if (last && int64_t(timestamps[n]) + playback.offset <= last) {
+		playback.offset = last - int64_t(timestamps[n]) + int64_t(bucketMicros);
+	}
+
+	positions[0] = n;
+	positions[1] = n;
+}
+
+//--------------------------------------------------------------
+void StereoReplay::seekTime(uint64_t recordedTimestamp)
+{
+	if (timestamps.empty()) return;
+	uint64_t n = findFrame(recordedTimestamp);
+	if (timestamps[n] < recordedTimestamp && n + 1 < timestamps.size()) n++;
+	seek(n);
+}
+
+//--------------------------------------------------------------
+void StereoReplay::setConsumed(uint64_t timestamp)
+{
+	if (timestamps.empty()) return;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// pairs replayed before the last seek don't count
+	int64_t recorded = int64_t(timestamp) - playback.offset;
+	if (recorded < int64_t(timestamps[playback.startFrame])) return;
+
+	uint64_t n = findFrame(recorded) + 1;
+	if (n > playback.consumed) {
+		playback.consumed = n;
+		playback.consumedMicros = ofGetElapsedTimeMicros();
+	}
+}
+
+//--------------------------------------------------------------
+void StereoReplay::update()
+{
+	if (timestamps.empty()) return;
+
+	if (bLoop && positions[0] >= timestamps.size() && positions[1] >= timestamps.size()) {
+		seek(0);
+		return;
+	}
+
+	// as fast as possible, both sides held back by pairs the app never got: count them as consumed
+	if (!bRealtime) {
+		std::unique_lock<std::mutex> lock(mutex);
+		uint64_t now = ofGetElapsedTimeMicros();
+		uint64_t handedOut = getPosition();
+		if (handedOut >= playback.consumed + MAX_AHEAD && now - playback.consumedMicros > MAX_STALL_MICROS) {
+			if (nUnmatched == 0) {
+				ofLogWarning("StereoReplay") << "frames " << playback.consumed << " - " << handedOut - 1 << " weren't paired, skipping past them (maxSkewMs below the recorded skew?)";
+			}
+			nUnmatched += handedOut - playback.consumed;
+			playback.consumed = handedOut;
+			playback.consumedMicros = now;
+		}
+	}
+}
+
+//--------------------------------------------------------------
+uint64_t StereoReplay::findFrame(uint64_t recordedTimestamp) const
+{
+	if (timestamps.empty() || recordedTimestamp <= timestamps.front()) return 0;
+
+	// first frame of the timestamp's bucket, then the few frames after it
+	uint64_t b = min<uint64_t>((recordedTimestamp - timestamps.front()) / bucketMicros, buckets.size() - 1);
+	uint64_t n = buckets[b];
+	if (n == timestamps.size() || timestamps[n] > recordedTimestamp) n--;	// the bucket starts after frame 0, so n > 0
+	while (n + 1 < timestamps.size() && timestamps[n + 1] <= recordedTimestamp) n++;
+	return n;
+}
+
+//--------------------------------------------------------------
+StereoReplay::Playback StereoReplay::getPlayback()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return playback;
+}
+
+//--------------------------------------------------------------
+int StereoReplay::Source::getWidth()
+{
+	return replay->header.width[index];
+}
+
+//--------------------------------------------------------------
+int StereoReplay::Source::getHeight()
+{
+	return replay->header.height[index];
+}
+
+//--------------------------------------------------------------
+void StereoReplay::Source::update()
+{
+	bFrameNew = false;
+
+	// position first: a seek after this makes the exchange below fail
+	uint64_t n = replay->positions[index];
+	Playback playback = replay->getPlayback();
+	const auto& timestamps = replay->timestamps;
+	if (n >= timestamps.size()) return;	// at the end, waiting for a seek / loop
+
+	uint64_t next = n;
+	if (replay->bRealtime) {
+		// recorded time playback has reached, overdue frames are skipped
+		uint64_t t = timestamps[playback.startFrame] + (ofGetElapsedTimeMicros() - playback.startMicros);
+		if (timestamps[n] > t) return;
+		next = max(n, replay->findFrame(t));
+	}
+	else if (n >= playback.consumed + MAX_AHEAD) {
+		return;
+	}
+
+	if (!replay->positions[index].compare_exchange_strong(n, next + 1)) return;
+
+	const auto& header = replay->header;
+	const uint8_t* pair = replay->getPair(next);
+	StereoRecorder::PairHeader pairHeader;
+	memcpy(&pairHeader, pair, sizeof(pairHeader));
+
+	// read-only mapping - StereoCapture only copies out of it
+	frame.setFromExternalPixels((unsigned char*)(pair + StereoRecorder::getFrameOffset(header, index)), header.width[index], header.height[index], header.channels[index]);
+	timestamp = uint64_t(int64_t(pairHeader.timestamp[index]) + playback.offset);
+
+	uint64_t last = replay->lastTimestamp;
+	while (timestamp > last && !replay->lastTimestamp.compare_exchange_weak(last, timestamp)) {}
+
+	bFrameNew = true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ofMain.h"
+#include "CameraSource.h"
+#include "MappedFile.h"
+#include "StereoRecorder.h"
+
+// plays a StereoRecorder recording back as a pair of camera sources, memory mapped
+//	- frames are handed to StereoCapture straight from the mapping, no decode and no copy of our own
+//	- real time: frames come out at their recorded intervals, a slow consumer skips frames like a live camera
+//	- as fast as possible: each side stays at most MAX_AHEAD frames ahead of the last pair the app consumed
+//	  (setConsumed()), so nothing is dropped and the pipeline runs flat out; frames the capture can't pair
+//	  (maxSkewMs under the recorded skew) are given up on after MAX_STALL_MICROS without a consumed pair
+//	- seek() by frame index and seekTime() by recorded timestamp are O(1): records are fixed size and
+//	  timestamps go through a table of frames per time bucket (one bucket per average frame interval)
+//	- timestamps are the recorded ones, shifted forward after seeking back / looping so they never decrease
+
+class StereoReplay {
+
+	public:
+
+		static const uint64_t MAX_AHEAD = 2;
+		static const uint64_t MAX_STALL_MICROS = 250000;
+
+		class Source : public CameraSource {
+
+			public:
+
+				void update() override;
+				bool isFrameNew() override { return bFrameNew; }
+				const ofPixels& getFrame() override { return frame; }
+				uint64_t getTimestamp() override { return timestamp; }
+
+				int getWidth() override;
+				int getHeight() override;
+
+			protected:
+
+				friend class StereoReplay;
+
+				StereoReplay* replay = nullptr;
+				int index = 0;
+				bool bFrameNew = false;
+				uint64_t timestamp = 0;
+				ofPixels frame;		// external, points into the mapping
+		};
+
+		bool open(const string& path);
+		void close();	// capture threads using the sources have to be stopped first
+
+		bool isOpen() const { return file.isOpen(); }
+		const StereoRecorder::FileHeader& getHeader() const { return header; }
+
+		Source& getSource(int i) { return sources[i]; }
+
+		void setRealtime(bool bRealtime);
+		bool getRealtime() const { return bRealtime; }
+		void setLoop(bool bLoop) { this->bLoop = bLoop; }
+		bool getLoop() const { return bLoop; }
+
+		uint64_t getNumFrames() const { return timestamps.size(); }
+		uint64_t getDuration() const { return timestamps.empty() ? 0 : timestamps.back() - timestamps.front(); }	// usec
+		uint64_t getRecordedTimestamp(uint64_t n) const { return timestamps[n]; }	// left
+
+		// next frame to play (the side that's further behind)
+		uint64_t getPosition() const;
+
+		// main thread
+		void seek(uint64_t n);
+		void seekTime(uint64_t recordedTimestamp);		// first frame at or after it
+		void setConsumed(uint64_t timestamp);			// the app took the pair with this (replayed) timestamp
+		void update();									// loops at the end, gives up on frames that never pair
+
+		uint64_t getNumUnmatched() const { return nUnmatched; }	// frames given up on
+
+		// last frame recorded at or before a timestamp, 0 if it's before the first
+		uint64_t findFrame(uint64_t recordedTimestamp) const;
+
+	protected:
+
+		// shared by both sources, guarded by mutex
+		struct Playback {
+			uint64_t startMicros = 0;	// host time startFrame was (re)started at
+			uint64_t startFrame = 0;
+			int64_t offset = 0;			// replayed - recorded timestamp
+			uint64_t consumed = 0;		// frames before this were taken by the app
+			uint64_t consumedMicros = 0;	// host time consumed last moved
+		};
+
+		Playback getPlayback();
+		const uint8_t* getPair(uint64_t n) const { return file.getData() + StereoRecorder::getPairOffset(header, n); }
+
+		MappedFile file;
+		StereoRecorder::FileHeader header;
+		vector<uint64_t> timestamps;	// left, per frame
+		vector<uint32_t> buckets;		// first frame at or after timestamps[0] + b * bucketMicros
+		uint64_t bucketMicros = 1;
+
+		Source sources[2];
+		std::atomic<uint64_t> positions[2];		// next frame per side
+		std::atomic<uint64_t> lastTimestamp{ 0 };	// latest replayed timestamp handed out
+		std::mutex mutex;
+		Playback playback;
+
+		uint64_t nUnmatched = 0;		// main thread
+
+		std::atomic<bool> bRealtime{ true };
+		bool bLoop = true;
+};
@@ -0,0 +1,255 @@
+#include "StereoSolver.h"
+#include "Parallel.h"
+
+using namespace cv;
+
+//--------------------------------------------------------------
+bool StereoSolver::solve(const vector<vector<Point3f>>& objectPoints,
+	const vector<vector<Point2f>>& imagePoints0, const vector<vector<Point2f>>& imagePoints1,
+	const Mat& K0, const Mat& D0, const Mat& K1, const Mat& D1, cv::Size imageSize,
+	Result& result) const
+{
+	return solve(settings.flags, objectPoints, imagePoints0, imagePoints1, K0, D0, K1, D1, imageSize, result);
+}
+
+//--------------------------------------------------------------
+bool StereoSolver::solve(int flags, const vector<vector<Point3f>>& objectPoints,
+	const vector<vector<Point2f>>& imagePoints0, const vector<vector<Point2f>>& imagePoints1,
+	const Mat& K0, const Mat& D0, const Mat& K1, const Mat& D1, cv::Size imageSize,
+	Result& result) const
+{
+	int n = (int)objectPoints.size();
+	if (n == 0 || (int)imagePoints0.size() != n || (int)imagePoints1.size() != n) {
+		ofLogError("StereoSolver") << "view count mismatch - object: " << n << ", [0]: " << imagePoints0.size() << ", [1]: " << imagePoints1.size();
+		return false;
+	}
+
+	vector<bool> kept(n, true);
+	result.dropped.clear();
+	result.iterations = 0;
+
+	while (true) {
+
+		// solve on the kept views, always from the starting intrinsics
+
+		vector<vector<Point3f>> obj;
+		vector<vector<Point2f>> img0, img1;
+		for (int i = 0; i < n; i++) {
+			if (!kept[i]) continue;
+			obj.push_back(objectPoints[i]);
+			img0.push_back(imagePoints0[i]);
+			img1.push_back(imagePoints1[i]);
+		}
+
+		result.K[0] = K0.clone();
+		result.D[0] = D0.clone();
+		result.K[1] = K1.clone();
+		result.D[1] = D1.clone();
+
+		try {
+			result.rms = stereoCalibrate(obj, img0, img1, result.K[0], result.D[0], result.K[1], result.D[1], imageSize,
+				result.R, result.T, result.E, result.F, flags);
+		}
+		catch (const cv::Exception& e) {
+			ofLogError("StereoSolver") << e.what();
+			return false;
+		}
+		result.iterations++;
+
+		getViewErrors(objectPoints, imagePoints0, imagePoints1, result.K, result.D, result.R, result.T, result.viewErrors);
+
+		if (settings.maxViewError <= 0 || result.iterations >= settings.maxIterations) break;
+
+		// drop kept views over the threshold, worst first, as long as enough are left
+
+		vector<int> over;
+		for (int i = 0; i < n; i++) {
+			if (kept[i] && result.viewErrors[i] > settings.maxViewError) over.push_back(i);
+		}
+		sort(over.begin(), over.end(), [&](int a, int b) { return result.viewErrors[a] > result.viewErrors[b]; });
+
+		int nKept = (int)obj.size();
+		int nDrop = min((int)over.size(), nKept - settings.minViews);
+		if (nDrop <= 0) break;
+
+		for (int k = 0; k < nDrop; k++) {
+			kept[over[k]] = false;
+			result.dropped.push_back(over[k]);
+		}
+		ofLogNotice("StereoSolver") << "iteration " << result.iterations << " - rms " << result.rms << ", dropping " << nDrop << " views over " << settings.maxViewError << " px";
+	}
+
+	sort(result.dropped.begin(), result.dropped.end());
+	return true;
+}
+
+//--------------------------------------------------------------
+vector<StereoSolver::Evaluation> StereoSolver::evaluate(const vector<Strategy>& strategies, const vector<vector<Point3f>>& objectPoints,
+	const vector<vector<Point2f>>& imagePoints0, const vector<vector<Point2f>>& imagePoints1,
+	const Mat& K0, const Mat& D0, const Mat& K1, const Mat& D1, cv::Size imageSize,
+	int holdOutEvery) const
+{
+	// split into training + held-out views
+
+	vector<vector<Point3f>> trainObj, testObj;
+	vector<vector<Point2f>> train0, train1, test0, test1;
+	for (size_t i = 0; i < objectPoints.size(); i++) {
+		bool bTest = holdOutEvery > 1 && i % holdOutEvery == holdOutEvery - 1;
+		(bTest ? testObj : trainObj).push_back(objectPoints[i]);
+		(bTest ? test0 : train0).push_back(imagePoints0[i]);
+		(bTest ? test1 : train1).push_back(imagePoints1[i]);
+	}
+	if (testObj.empty() || (int)trainObj.size() < settings.minViews) {
+		ofLogWarning("StereoSolver") << "only " << objectPoints.size() << " views, testing on the training views";
+		testObj = trainObj = objectPoints;
+		test0 = train0 = imagePoints0;
+		test1 = train1 = imagePoints1;
+	}
+
+	// rectification doesn't change the calibration, strategies differing only in that are solved and ranked once
+	// (the first of them stands for all)
+
+	vector<Strategy> distinct;
+	for (auto& strategy : strategies) {
+		auto same = find_if(distinct.begin(), distinct.end(), [&](const Strategy& s) { return s.flags == strategy.flags; });
+		if (same == distinct.end()) {
+			distinct.push_back(strategy);
+		}
+		else {
+			ofLogNotice("StereoSolver") << "not ranking " << strategy.name << ", same calibration flags as " << same->name;
+		}
+	}
+
+	// one strategy per task, each with its own outlier rejection on the training views
+
+	vector<Evaluation> evaluations(distinct.size());
+	parallelFor(0, (int)distinct.size(), [&](int k) {
+		Evaluation& eval = evaluations[k];
+		eval.strategy = distinct[k];
+
+		Result result;
+		if (!solve(eval.strategy.flags, trainObj, train0, train1, K0, D0, K1, D1, imageSize, result)) return;
+		eval.rms = result.rms;
+
+		// reprojection on unseen views
+		vector<double> errors;
+		getViewErrors(testObj, test0, test1, result.K, result.D, result.R, result.T, errors);
+		double sum = 0;
+		for (double e : errors) sum += e * e;
+		eval.heldOutError = sqrt(sum / errors.size());
+
+		// corners of unseen views should land on the same row after rectification
+		// (default rectification for every strategy, its flags / alpha only rescale the error)
+		Mat R0, R1, P0, P1, Q;
+		try {
+			stereoRectify(result.K[0], result.D[0], result.K[1], result.D[1], imageSize, result.R, result.T, R0, R1, P0, P1, Q);
+		}
+		catch (const cv::Exception& e) {
+			ofLogError("StereoSolver") << eval.strategy.name << ": " << e.what();
+			return;
+		}
+		double rowSum = 0;
+		size_t nPts = 0;
+		for (size_t i = 0; i < testObj.size(); i++) {
+			vector<Point2f> rect0, rect1;
+			undistortPoints(test0[i], rect0, result.K[0], result.D[0], R0, P0);
+			undistortPoints(test1[i], rect1, result.K[1], result.D[1], R1, P1);
+			for (size_t j = 0; j < rect0.size(); j++) {
+				rowSum += abs(rect0[j].y - rect1[j].y);
+			}
+			nPts += rect0.size();
+		}
+		eval.epipolarError = nPts ? rowSum / nPts : 0;
+		eval.bOk = std::isfinite(eval.getScore());
+	});
+
+	stable_sort(evaluations.begin(), evaluations.end(), [](const Evaluation& a, const Evaluation& b) {
+		if (a.bOk != b.bOk) return a.bOk;
+		return a.getScore() < b.getScore();
+	});
+	return evaluations;
+}
+
+//--------------------------------------------------------------
+int StereoSolver::parseFlags(const string& names)
+{
+	static const map<string, int> flagNames = {
+		{ "FIX_INTRINSIC", CALIB_FIX_INTRINSIC },
+		{ "USE_INTRINSIC_GUESS", CALIB_USE_INTRINSIC_GUESS },
+		{ "FIX_PRINCIPAL_POINT", CALIB_FIX_PRINCIPAL_POINT },
+		{ "FIX_FOCAL_LENGTH", CALIB_FIX_FOCAL_LENGTH },
+		{ "FIX_ASPECT_RATIO", CALIB_FIX_ASPECT_RATIO },
+		{ "SAME_FOCAL_LENGTH", CALIB_SAME_FOCAL_LENGTH },
+		{ "ZERO_TANGENT_DIST", CALIB_ZERO_TANGENT_DIST },
+		{ "FIX_K3", CALIB_FIX_K3 },
+		{ "RATIONAL_MODEL", CALIB_RATIONAL_MODEL },
+		{ "THIN_PRISM_MODEL", CALIB_THIN_PRISM_MODEL },
+		{ "FIX_S1_S2_S3_S4", CALIB_FIX_S1_S2_S3_S4 },
+	};
+	return parseFlags(names, flagNames, "calibration");
+}
+
+//--------------------------------------------------------------
+int StereoSolver::parseRectifyFlags(const string& names)
+{
+	static const map<string, int> flagNames = {
+		{ "ZERO_DISPARITY", CALIB_ZERO_DISPARITY },
+	};
+	return parseFlags(names, flagNames, "rectification");
+}
+
+//--------------------------------------------------------------
+int StereoSolver::parseFlags(const string& names, const map<string, int>& flagNames, const string& kind)
+{
+	int flags = 0;
+	for (auto& name : ofSplitString(names, "|", true, true)) {
+		auto it = flagNames.find(name);
+		if (it == flagNames.end()) {
+			ofLogError("StereoSolver") << "unknown " << kind << " flag " << name;
+			continue;
+		}
+		flags |= it->second;
+	}
+	return flags;
+}
+
+//--------------------------------------------------------------
+void StereoSolver::getViewErrors(const vector<vector<Point3f>>& objectPoints,
+	const vector<vector<Point2f>>& imagePoints0, const vector<vector<Point2f>>& imagePoints1,
+	const Mat K[2], const Mat D[2], const Mat& R, const Mat& T, vector<double>& errors)
+{
+	int n = (int)objectPoints.size();
+	errors.assign(n, 0);
+
+	Mat R64, T64;
+	R.convertTo(R64, CV_64F);
+	T.convertTo(T64, CV_64F);
+
+	parallelFor(0, n, [&](int i) {
+
+		// board pose in cam 0
+		Mat rvec0, tvec0;
+		if (!solvePnP(objectPoints[i], imagePoints0[i], K[0], D[0], rvec0, tvec0)) {
+			errors[i] = std::numeric_limits<double>::infinity();
+			return;
+		}
+
+		// same pose seen from cam 1
+		Mat R0, rvec1;
+		Rodrigues(rvec0, R0);
+		Rodrigues(R64 * R0, rvec1);
+		Mat tvec1 = R64 * tvec0 + T64;
+
+		vector<Point2f> projected0, projected1;
+		projectPoints(objectPoints[i], rvec0, tvec0, K[0], D[0], projected0);
+		projectPoints(objectPoints[i], rvec1, tvec1, K[1], D[1], projected1);
+
+		double sum = 0;
+		for (size_t k = 0; k < projected0.size(); k++) {
+			Point2f d0 = projected0[k] - imagePoints0[i][k];
+			Point2f d1 = projected1[k] - imagePoints1[i][k];
+			sum += d0.dot(d0) + d1.dot(d1);
+		}
+		errors[i] = sqrt(sum / (2 * projected0.size()));
+	});
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+// cv::stereoCalibrate with per-view diagnostics and outlier rejection
+//	- after each solve every view's reprojection error is computed (in parallel): the board pose is solved
+//	  from the left view, projected into the left camera and through R / T into the right one
+//	- views above maxViewError are dropped and the rest re-solved, until no view is dropped
+//	  (or maxIterations / minViews is reached)
+//	- evaluate() solves several flag strategies concurrently and ranks them on held-out views
+
+class StereoSolver {
+
+	public:
+
+		struct Settings {
+			int flags = cv::CALIB_FIX_INTRINSIC;	// cv::stereoCalibrate flags
+			double maxViewError = 0;				// px, 0 = keep every view
+			int maxIterations = 5;
+			int minViews = 5;						// never drop below this many views
+		};
+
+		struct Result {
+			cv::Mat K[2], D[2];
+			cv::Mat R, T, E, F;
+			double rms = 0;					// cv::stereoCalibrate's rms over the kept views (px)
+			vector<double> viewErrors;		// per input view (px), at the final solution, dropped views included
+			vector<int> dropped;			// input view indices left out of the final solve
+			int iterations = 0;
+		};
+
+		// stereoCalibrate + stereoRectify options to try
+		struct Strategy {
+			string name;
+			int flags = cv::CALIB_FIX_INTRINSIC;	// cv::stereoCalibrate flags
+			int rectifyFlags = 0;					// cv::stereoRectify flags
+			double alpha = -1;						// cv::stereoRectify alpha
+		};
+
+		struct Evaluation {
+			Strategy strategy;
+			bool bOk = false;
+			double rms = 0;				// on the training views (px)
+			double heldOutError = 0;	// rms reprojection error on the held-out views (px)
+			double epipolarError = 0;	// mean row difference of held-out corners after rectification (px)
+			double getScore() const { return heldOutError + epipolarError; }	// lower is better
+		};
+
+		void setup(const Settings& settings) { this->settings = settings; }
+		const Settings& getSettings() const { return settings; }
+
+		// K / D are the starting intrinsics (kept as they are with CALIB_FIX_INTRINSIC)
+		bool solve(const vector<vector<cv::Point3f>>& objectPoints,
+			const vector<vector<cv::Point2f>>& imagePoints0, const vector<vector<cv::Point2f>>& imagePoints1,
+			const cv::Mat& K0, const cv::Mat& D0, const cv::Mat& K1, const cv::Mat& D1, cv::Size imageSize,
+			Result& result) const;
+		// same with different stereoCalibrate flags
+		bool solve(int flags, const vector<vector<cv::Point3f>>& objectPoints,
+			const vector<vector<cv::Point2f>>& imagePoints0, const vector<vector<cv::Point2f>>& imagePoints1,
+			const cv::Mat& K0, const cv::Mat& D0, const cv::Mat& K1, const cv::Mat& D1, cv::Size imageSize,
+			Result& result) const;
+
+		// solve every strategy in parallel on all but every holdOutEvery-th view, test on those
+		// one evaluation per distinct set of stereoCalibrate flags, sorted best first, failed strategies last
+		vector<Evaluation> evaluate(const vector<Strategy>& strategies, const vector<vector<cv::Point3f>>& objectPoints,
+			const vector<vector<cv::Point2f>>& imagePoints0, const vector<vector<cv::Point2f>>& imagePoints1,
+			const cv::Mat& K0, const cv::Mat& D0, const cv::Mat& K1, const cv::Mat& D1, cv::Size imageSize,
+			int holdOutEvery = 5) const;
+
+		// "USE_INTRINSIC_GUESS|RATIONAL_MODEL" -> cv::stereoCalibrate flags, unknown names are logged and ignored
+		static int parseFlags(const string& names);
+		// "ZERO_DISPARITY" -> cv::stereoRectify flags, same
+		static int parseRectifyFlags(const string& names);
+
+		// rms reprojection error of each view for a stereo calibration, in parallel
+		static void getViewErrors(const vector<vector<cv::Point3f>>& objectPoints,
+			const vector<vector<cv::Point2f>>& imagePoints0, const vector<vector<cv::Point2f>>& imagePoints1,
+			const cv::Mat K[2], const cv::Mat D[2], const cv::Mat& R, const cv::Mat& T, vector<double>& errors);
+
+	protected:
+
+		static int parseFlags(const string& names, const map<string, int>& flagNames, const string& kind);
+
+		Settings settings;
+};
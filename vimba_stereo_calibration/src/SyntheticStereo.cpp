@@ -0,0 +1,275 @@
+#include "SyntheticStereo.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+//--------------------------------------------------------------
+void SyntheticStereo::readSettings(const FileNode& node, Settings& s)
+{
+	if (node.empty()) return;
+
+	auto readSeq = [](const FileNode& n) {
+		vector<double> v;
+		for (auto it = n.begin(); it != n.end(); ++it) v.push_back((double)*it);
+		return v;
+	};
+
+	if (!node["width"].empty() && !node["height"].empty()) s.size = cv::Size((int)node["width"], (int)node["height"]);
+	if (!node["fps"].empty()) s.fps = (float)node["fps"];
+
+	const char* kNames[2] = { "K0", "K1" };
+	const char* dNames[2] = { "D0", "D1" };
+	for (int i = 0; i < 2; i++) {
+		vector<double> k = readSeq(node[kNames[i]]);	// fx, fy, cx, cy
+		if (k.size() == 4) s.K[i] = Matx33d(k[0], 0, k[2], 0, k[1], k[3], 0, 0, 1);
+		vector<double> d = readSeq(node[dNames[i]]);	// k1, k2, p1, p2, k3
+		if (!d.empty()) {
+			d.resize(5, 0.);
+			s.D[i] = Mat(d, true);
+		}
+	}
+
+	vector<double> r = readSeq(node["R"]);	// rodrigues, rad
+	if (r.size() == 3) {
+		Mat R;
+		Rodrigues(Vec3d(r[0], r[1], r[2]), R);
+		s.R = Matx33d(R.ptr<double>());
+	}
+	vector<double> t = readSeq(node["T"]);
+	if (t.size() == 3) s.T = Vec3d(t[0], t[1], t[2]);
+
+	if (!node["noise"].empty()) s.noise = (double)node["noise"];
+	if (!node["motionBlur"].empty()) s.motionBlur = (double)node["motionBlur"];
+	if (!node["blurSamples"].empty()) s.blurSamples = (int)node["blurSamples"];
+	if (!node["seed"].empty()) s.seed = (int)node["seed"];
+}
+
+//--------------------------------------------------------------
+bool SyntheticStereo::setup(const Settings& settings)
+{
+	if (settings.size.area() == 0 || settings.patternSize.area() == 0 || settings.squareSize <= 0) {
+		ofLogError("SyntheticStereo") << "needs an image size, pattern size and square size";
+		return false;
+	}
+	this->settings = settings;
+	for (auto& D : this->settings.D) {
+		if (D.empty()) D = Mat::zeros(5, 1, CV_64F);
+	}
+
+	// board texture, 64 px per square
+
+	const int px = 64;
+	cv::Size p = settings.patternSize;
+	texture = Mat((p.height + 3) * px, (p.width + 3) * px, CV_8UC1, Scalar(255));
+	for (int y = 0; y <= p.height; y++) {
+		for (int x = 0; x <= p.width; x++) {
+			if ((x + y) % 2 == 0) {
+				rectangle(texture, cv::Rect((x + 1) * px, (y + 1) * px, px, px), Scalar(0), FILLED);
+			}
+		}
+	}
+	double scale = px / settings.squareSize;
+	boardToTexture = Matx33d(scale, 0, 2 * px, 0, scale, 2 * px, 0, 0, 1);	// first inner corner at (2, 2) squares
+
+	// viewing ray of every (distorted) pixel, z = 1
+
+	cv::Size size = settings.size;
+	vector<Point2f> pixels;
+	pixels.reserve(size.area());
+	for (int y = 0; y < size.height; y++) {
+		for (int x = 0; x < size.width; x++) {
+			pixels.emplace_back(x, y);
+		}
+	}
+	for (int i = 0; i < 2; i++) {
+		vector<Point2f> undistorted;
+		undistortPoints(pixels, undistorted, Mat(settings.K[i]), this->settings.D[i]);
+		rays[i] = Mat(undistorted, true).reshape(2, size.height);
+	}
+
+	// board travel: fills at most half the view, stays in it when closest
+
+	double sq = settings.squareSize;
+	boardCentre = Vec3d((p.width - 1) * sq / 2, (p.height - 1) * sq / 2, 0);
+	double boardW = (p.width + 1) * sq, boardH = (p.height + 1) * sq;
+	double fx = settings.K[0](0, 0), fy = settings.K[0](1, 1);
+	z0 = max(boardW * fx / (0.5 * size.width), boardH * fy / (0.5 * size.height));
+	double zNear = 0.75 * z0;
+	amplitude[0] = 0.8 * max(0., size.width / 2. / fx * zNear - boardW / 2);
+	amplitude[1] = 0.8 * max(0., size.height / 2. / fy * zNear - boardH / 2);
+
+	startMicros = ofGetElapsedTimeMicros();
+	for (int i = 0; i < 2; i++) {
+		cams[i].rig = this;
+		cams[i].index = i;
+		cams[i].frameNum = 0;
+		cams[i].bFrameNew = false;
+		numRendered[i] = 0;
+	}
+
+	ofLogNotice("SyntheticStereo") << size << " @ " << settings.fps << " fps, board at " << z0 << " +-25%, noise " << settings.noise << ", motion blur " << settings.motionBlur;
+	return true;
+}
+
+//--------------------------------------------------------------
+void SyntheticStereo::getBoardPose(double t, Matx33d& R, Vec3d& T) const
+{
+	// incommensurate periods (sec) sweep position, distance and tilt, the seed shifts the phases
+
+	const double tau = 2 * PI;
+	double ph = settings.seed * 0.618;
+
+	Vec3d rvec(0.5 * sin(tau * t / 6.7 + ph), 0.5 * sin(tau * t / 8.9 + 2 * ph + 1), 0.3 * sin(tau * t / 13.7 + 3 * ph + 2));
+	Mat rm;
+	Rodrigues(rvec, rm);
+	R = Matx33d(rm.ptr<double>());
+
+	Vec3d centre(amplitude[0] * sin(tau * t / 7.3 + 4 * ph),
+		amplitude[1] * sin(tau * t / 5.9 + 5 * ph + 0.5),
+		z0 * (1 + 0.25 * sin(tau * t / 11.1 + 6 * ph)));
+	T = centre - R * boardCentre;
+}
+
+//--------------------------------------------------------------
+void SyntheticStereo::renderView(int i, double t, Mat& dst, Mat& map) const
+{
+	Matx33d Rb;
+	Vec3d tb;
+	getBoardPose(t, Rb, tb);
+	if (i == 1) {
+		tb = settings.R * tb + settings.T;
+		Rb = settings.R * Rb;
+	}
+
+	// board plane (X, Y, 1) -> normalized image coords is [r1 r2 t], inverted: ray -> board -> texture
+	// (the board never tilts far enough for its horizon to be in view)
+	Matx33d H(Rb(0, 0), Rb(0, 1), tb[0], Rb(1, 0), Rb(1, 1), tb[1], Rb(2, 0), Rb(2, 1), tb[2]);
+	Matx33d M = boardToTexture * H.inv();
+
+	perspectiveTransform(rays[i], map, M);
+	remap(texture, dst, map, noArray(), INTER_LINEAR, BORDER_CONSTANT, Scalar(96));
+}
+
+//--------------------------------------------------------------
+void SyntheticStereo::render(int i, uint64_t n, Buffers& buf) const
+{
+	double frameTime = getFrameTime();
+	double t = n * frameTime;
+	int samples = settings.motionBlur > 0 ? max(2, settings.blurSamples) : 1;
+
+	if (samples == 1 && settings.noise <= 0) {
+		renderView(i, t, buf.view, buf.map);
+		return;
+	}
+
+	// shutter open from t for motionBlur of the frame time
+	buf.acc.create(settings.size, CV_32F);
+	buf.acc = Scalar(0);
+	for (int k = 0; k < samples; k++) {
+		double dt = samples > 1 ? settings.motionBlur * frameTime * k / (samples - 1) : 0;
+		renderView(i, t + dt, buf.view, buf.map);
+		accumulate(buf.view, buf.acc);
+	}
+
+	if (settings.noise > 0) {
+		// same noise for the same frame, camera and seed
+		RNG rng((uint64)settings.seed * 0x9E3779B97F4A7C15ULL + n * 2 + i + 1);
+		buf.noise.create(settings.size, CV_32F);
+		rng.fill(buf.noise, RNG::NORMAL, 0, settings.noise * samples);
+		buf.acc += buf.noise;
+	}
+
+	buf.acc.convertTo(buf.view, CV_8U, 1. / samples);
+}
+
+//--------------------------------------------------------------
+string SyntheticStereo::compare(const Mat K[2], const Mat D[2], const Mat& R, const Mat& T) const
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(3);
+
+	for (int i = 0; i < 2; i++) {
+		Mat k;
+		K[i].convertTo(k, CV_64F);
+		const Matx33d& truth = settings.K[i];
+		ss << (i ? "\nR" : "L") << " - fx " << k.at<double>(0, 0) << " (truth " << truth(0, 0) << ", err " << k.at<double>(0, 0) - truth(0, 0) << ")"
+			<< ", fy " << k.at<double>(1, 1) << " (" << truth(1, 1) << ", " << k.at<double>(1, 1) - truth(1, 1) << ")"
+			<< ", cx " << k.at<double>(0, 2) << " (" << truth(0, 2) << ", " << k.at<double>(0, 2) - truth(0, 2) << ")"
+			<< ", cy " << k.at<double>(1, 2) << " (" << truth(1, 2) << ", " << k.at<double>(1, 2) - truth(1, 2) << ") px";
+
+		// k1 k2 p1 p2 k3, richer models are compared on those
+		Mat d;
+		D[i].reshape(1, (int)D[i].total()).convertTo(d, CV_64F);
+		ss << "\n    distortion";
+		for (int j = 0; j < 5; j++) {
+			double solved = j < d.rows ? d.at<double>(j) : 0;
+			ss << " " << solved << " (" << settings.D[i].at<double>(j) << ")";
+		}
+	}
+
+	Mat r, t;
+	R.convertTo(r, CV_64F);
+	T.reshape(1, 3).convertTo(t, CV_64F);
+
+	// rotation error as the angle of R * R_truth^-1
+	Vec3d dr;
+	Rodrigues(Mat(r * Mat(settings.R).t()), dr);
+	Vec3d ts(t.ptr<double>());
+	double baseline = norm(settings.T);
+	double dir = acos(ofClamp(ts.dot(settings.T) / (norm(ts) * baseline), -1, 1));
+
+	ss << "\nstereo - rotation err " << ofRadToDeg(norm(dr)) << " deg"
+		<< ", baseline " << norm(ts) << " (truth " << baseline << ", err " << (norm(ts) - baseline) / baseline * 100 << "%)"
+		<< ", direction err " << ofRadToDeg(dir) << " deg";
+
+	return ss.str();
+}
+
+//--------------------------------------------------------------
+int SyntheticStereo::Camera::getWidth()
+{
+	return rig->settings.nClockwiseRotations % 2 ? rig->settings.size.height : rig->settings.size.width;
+}
+
+//--------------------------------------------------------------
+int SyntheticStereo::Camera::getHeight()
+{
+	return rig->settings.nClockwiseRotations % 2 ? rig->settings.size.width : rig->settings.size.height;
+}
+
+//--------------------------------------------------------------
+void SyntheticStereo::Camera::update()
+{
+	bFrameNew = false;
+
+	const Settings& s = rig->settings;
+	uint64_t frameMicros = uint64_t(rig->getFrameTime() * 1e6);
+
+	if (s.fps > 0) {
+		// frame n is due at n / fps, running late skips to the latest due frame like a camera nobody read out
+		uint64_t now = ofGetElapsedTimeMicros();
+		if (now < rig->startMicros + frameNum * frameMicros) return;
+		frameNum = (now - rig->startMicros) / frameMicros;
+	}
+	else if (frameNum > rig->numRendered[1 - index]) {
+		return;	// as fast as possible, but not ahead of the other view
+	}
+
+	rig->render(index, frameNum, buffers);
+
+	// grey -> camera pixel format, then back to raw sensor orientation
+	calibrated.allocate(s.size.width, s.size.height, s.channels);
+	Mat dst = toCv(calibrated);
+	if (s.channels == 1) {
+		buffers.view.copyTo(dst);
+	}
+	else {
+		cvtColor(buffers.view, dst, s.channels == 4 ? COLOR_GRAY2RGBA : COLOR_GRAY2RGB);
+	}
+	calibrated.rotate90To(frame, s.nClockwiseRotations);
+
+	timestamp = rig->startMicros + frameNum * frameMicros;
+	frameNum++;
+	rig->numRendered[index] = frameNum;
+	bFrameNew = true;
+}
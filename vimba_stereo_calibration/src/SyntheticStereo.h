@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "CameraSource.h"
+
+// virtual stereo rig: two cameras rendering a moving checkerboard through known calibration
+//	- ground truth intrinsics, distortion (k1 k2 p1 p2 k3) and extrinsics (x1 = R x0 + T) are given
+//	  for the calibrated (rotated) image orientation, so they compare directly with a solved calibration
+//	- frames come out in raw sensor orientation, i.e. turned back by the app's sensor rotation
+//	- the board pose is a smooth function of the frame number and seed, so both views of a frame
+//	  show the same pose and a run is repeatable frame for frame
+//	- optional gaussian noise and motion blur (several poses averaged over the shutter time)
+//	- fps 0 renders as fast as possible, timestamps then advance on a 30 fps virtual clock
+
+class SyntheticStereo {
+
+	public:
+
+		struct Settings {
+			cv::Size size = cv::Size(1216, 1936);	// calibrated image size
+			int nClockwiseRotations = 0;			// raw frame = calibrated image turned this many times
+			int channels = 3;						// 1 = mono / bayer, 3 = RGB
+			float fps = 30;
+
+			cv::Size patternSize = cv::Size(6, 9);	// inner corners
+			float squareSize = 1;
+
+			cv::Matx33d K[2] = { cv::Matx33d::eye(), cv::Matx33d::eye() };
+			cv::Mat D[2];							// 5 x 1, empty = no distortion
+			cv::Matx33d R = cv::Matx33d::eye();	// cam 0 -> cam 1
+			cv::Vec3d T = cv::Vec3d(-20, 0, 0);		// calibration units (as squareSize)
+
+			double noise = 0;			// gaussian sigma, grey levels
+			double motionBlur = 0;		// fraction of the frame time the shutter is open, 0 = sharp
+			int blurSamples = 4;		// poses averaged over the shutter time
+			int seed = 1;
+		};
+
+		// render buffers, calibrated orientation
+		struct Buffers {
+			cv::Mat view;	// CV_8UC1 result
+			cv::Mat acc, noise, map;
+		};
+
+		class Camera : public CameraSource {
+
+			public:
+
+				void update() override;
+				bool isFrameNew() override { return bFrameNew; }
+				const ofPixels& getFrame() override { return frame; }
+				uint64_t getTimestamp() override { return timestamp; }
+
+				int getWidth() override;
+				int getHeight() override;
+
+			protected:
+
+				friend class SyntheticStereo;
+
+				SyntheticStereo* rig = nullptr;
+				int index = 0;
+				uint64_t frameNum = 0;
+				bool bFrameNew = false;
+				uint64_t timestamp = 0;
+
+				Buffers buffers;
+				ofPixels calibrated, frame;
+		};
+
+		// K / D / R / T / size / fps / noise... from config.yml's "synthetic" node, missing keys keep their value
+		static void readSettings(const cv::FileNode& node, Settings& settings);
+
+		bool setup(const Settings& settings);
+		const Settings& getSettings() const { return settings; }
+
+		Camera& getCamera(int i) { return cams[i]; }
+
+		// board pose in camera 0 at time t (sec) - rotation + translation of the first inner corner
+		void getBoardPose(double t, cv::Matx33d& R, cv::Vec3d& T) const;
+
+		// camera i's calibrated view of frame n, noise and blur included, into buffers.view
+		void render(int i, uint64_t n, Buffers& buffers) const;
+
+		// solved calibration against the ground truth, one line per parameter
+		string compare(const cv::Mat K[2], const cv::Mat D[2], const cv::Mat& R, const cv::Mat& T) const;
+
+	protected:
+
+		// one sharp view at time t into dst (CV_8UC1)
+		void renderView(int i, double t, cv::Mat& dst, cv::Mat& map) const;
+
+		double getFrameTime() const { return 1. / (settings.fps > 0 ? settings.fps : 30); }
+
+		Settings settings;
+
+		cv::Mat texture;				// the board, one white square of margin all around
+		cv::Matx33d boardToTexture;		// board units -> texture px
+		cv::Mat rays[2];				// per pixel undistorted normalized coords (CV_32FC2)
+
+		cv::Vec3d boardCentre;			// board units
+		double z0 = 100;				// distance the board moves around
+		cv::Vec2d amplitude;			// lateral travel
+
+		Camera cams[2];
+		uint64_t startMicros = 0;
+		std::atomic<uint64_t> numRendered[2];	// per camera, keeps the views in step when rendering as fast as possible
+};
@@ -0,0 +1,151 @@
+#include "VimbaSource.h"
+
+using namespace AVT::VmbAPI;
+
+//--------------------------------------------------------------
+VimbaSource::~VimbaSource()
+{
+	close();
+}
+
+//--------------------------------------------------------------
+bool VimbaSource::open(const string& id, const string& pixelFormat, int numBuffers)
+{
+	close();
+
+	// startup / shutdown are reference counted, close() shuts down again
+	VimbaSystem& system = VimbaSystem::GetInstance();
+	if (system.Startup() != VmbErrorSuccess) {
+		ofLogError("VimbaSource") << "can't start Vimba";
+		return false;
+	}
+	if (system.OpenCameraByID(id.c_str(), VmbAccessModeFull, camera) != VmbErrorSuccess) {
+		ofLogError("VimbaSource") << "can't open camera " << id;
+		camera.reset();
+		system.Shutdown();
+		return false;
+	}
+
+	// the format has to be set before streaming, one we can't use is reported as frames arrive
+	FeaturePtr feature;
+	if (!pixelFormat.empty()) {
+		if (camera->GetFeatureByName("PixelFormat", feature) == VmbErrorSuccess && feature->SetValue(pixelFormat.c_str()) == VmbErrorSuccess) {
+			ofLogNotice("VimbaSource") << id << " sending " << pixelFormat;
+		}
+		else {
+			ofLogError("VimbaSource") << "can't set PixelFormat " << pixelFormat << " on " << id << ", keeping the camera's format";
+		}
+	}
+
+	VmbInt64_t w = 0, h = 0;
+	if (camera->GetFeatureByName("Width", feature) == VmbErrorSuccess) feature->GetValue(w);
+	if (camera->GetFeatureByName("Height", feature) == VmbErrorSuccess) feature->GetValue(h);
+	width = (int)w;
+	height = (int)h;
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		bReceived = false;
+	}
+	bFrameNew = false;
+	nIncomplete = 0;
+	bFormatWarned = false;
+
+	if (camera->StartContinuousImageAcquisition(max(2, numBuffers), IFrameObserverPtr(new Observer(camera, this))) != VmbErrorSuccess) {
+		ofLogError("VimbaSource") << "can't start streaming from " << id;
+		close();
+		return false;
+	}
+	bStarted = true;
+
+	ofLogNotice("VimbaSource") << id << " streaming " << width << "x" << height;
+	return true;
+}
+
+//--------------------------------------------------------------
+void VimbaSource::close()
+{
+	if (!camera) return;
+
+	// no callbacks after this returns
+	if (bStarted) camera->StopContinuousImageAcquisition();
+	bStarted = false;
+	camera->Close();
+	camera.reset();
+	VimbaSystem::GetInstance().Shutdown();
+}
+
+//--------------------------------------------------------------
+void VimbaSource::update()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	bFrameNew = cond.wait_for(lock, std::chrono::microseconds(waitMicros), [this] { return bReceived; });
+	if (!bFrameNew) return;
+
+	// the capture thread copies out of frame before the next update(), received gets reused
+	frame.swap(received);
+	timestamp = receivedTimestamp;
+	bReceived = false;
+}
+
+//--------------------------------------------------------------
+void VimbaSource::Observer::FrameReceived(const FramePtr frame)
+{
+	source->receive(frame, ofGetElapsedTimeMicros());	// before anything else, it's the frame's timestamp
+	m_pCamera->QueueFrame(frame);
+}
+
+//--------------------------------------------------------------
+void VimbaSource::receive(const FramePtr& frame, uint64_t arrival)
+{
+	VmbFrameStatusType status;
+	if (frame->GetReceiveStatus(status) != VmbErrorSuccess || status != VmbFrameStatusComplete) {
+		nIncomplete++;
+		return;
+	}
+
+	VmbUint32_t w = 0, h = 0;
+	VmbPixelFormatType format;
+	VmbUchar_t* data = nullptr;
+	if (frame->GetWidth(w) != VmbErrorSuccess || frame->GetHeight(h) != VmbErrorSuccess
+		|| frame->GetPixelFormat(format) != VmbErrorSuccess || frame->GetImage(data) != VmbErrorSuccess || !data) {
+		nIncomplete++;
+		return;
+	}
+
+	int channels = getNumChannels(format);
+	if (!channels) {
+		if (!bFormatWarned) ofLogError("VimbaSource") << "unsupported pixel format 0x" << ofToHex((uint32_t)format) << ", frames are dropped";
+		bFormatWarned = true;
+		return;
+	}
+
+	// copy outside the lock, the capture thread only waits for the swap
+	incoming.allocate(w, h, channels);
+	memcpy(incoming.getData(), data, incoming.getTotalBytes());
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		received.swap(incoming);	// an unclaimed frame is replaced by the newer one
+		receivedTimestamp = arrival;
+		bReceived = true;
+	}
+	cond.notify_one();
+}
+
+//--------------------------------------------------------------
+int VimbaSource::getNumChannels(VmbPixelFormatType format)
+{
+	switch (format) {
+		case VmbPixelFormatRgb8:
+			return 3;
+		case VmbPixelFormatMono8:
+		case VmbPixelFormatBayerRG8:
+		case VmbPixelFormatBayerGR8:
+		case VmbPixelFormatBayerGB8:
+		case VmbPixelFormatBayerBG8:
+			return 1;
+		default:
+			return 0;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ofMain.h"
+#include "VimbaCPP/Include/VimbaCPP.h"
+#include "CameraSource.h"
+
+// Vimba camera as a CameraSource, streaming through VimbaCPP
+//	- Vimba delivers frames on its own thread (FrameReceived), the latest one is copied out and handed
+//	  to the capture thread, whose update() waits for it - no polling, nothing on the main thread
+//	- timestamps are host times (ofGetElapsedTimeMicros) taken in the frame callback: the cameras' own
+//	  tick counters aren't synchronized, callback times of both cameras are on the same clock
+//	- open() sets the camera's PixelFormat feature before streaming, 8 bit formats are supported:
+//	  RGB8 (3 channels), Mono8 and Bayer**8 (1 channel, raw mosaic)
+
+class VimbaSource : public CameraSource {
+
+	public:
+
+		~VimbaSource();
+
+		// pixelFormat: GenICam name ("RGB8", "Mono8", "BayerRG8"...), empty = leave the camera's setting
+		bool open(const string& id, const string& pixelFormat = "", int numBuffers = 4);
+		void close();
+		bool isOpen() const { return (bool)camera; }
+
+		// capture thread: takes the latest frame from the callback, waits up to waitMicros for one
+		void update() override;
+		bool isFrameNew() override { return bFrameNew; }
+		const ofPixels& getFrame() override { return frame; }
+		uint64_t getTimestamp() override { return timestamp; }
+
+		int getWidth() override { return width; }
+		int getHeight() override { return height; }
+
+		uint64_t getNumIncomplete() const { return nIncomplete; }	// frames Vimba delivered broken
+
+	protected:
+
+		class Observer : public AVT::VmbAPI::IFrameObserver {
+			public:
+				Observer(AVT::VmbAPI::CameraPtr camera, VimbaSource* source) : IFrameObserver(camera), source(source) {}
+				void FrameReceived(const AVT::VmbAPI::FramePtr frame) override;
+			protected:
+				VimbaSource* source;
+		};
+
+		// Vimba's thread
+		void receive(const AVT::VmbAPI::FramePtr& frame, uint64_t arrival);
+
+		static int getNumChannels(VmbPixelFormatType format);	// 0 = not supported
+
+		AVT::VmbAPI::CameraPtr camera;
+		bool bStarted = false;
+		int width = 0, height = 0;
+		uint64_t waitMicros = 5000;
+
+		// Vimba's thread -> capture thread, guarded by mutex
+		std::mutex mutex;
+		std::condition_variable cond;
+		ofPixels incoming;			// Vimba's thread only, swapped into received
+		ofPixels received;
+		uint64_t receivedTimestamp = 0;
+		bool bReceived = false;
+		std::atomic<uint64_t> nIncomplete{ 0 };
+		bool bFormatWarned = false;	// Vimba's thread
+
+		// capture thread
+		ofPixels frame;
+		uint64_t timestamp = 0;
+		bool bFrameNew = false;
+};
@@ -1,4 +1,5 @@
 #include "ofApp.h"
+#include "Parallel.h"
 
 using namespace ofxCv;
 using namespace cv;
@@ -7,6 +8,8 @@ using namespace cv;
 
 const string CONFIG_FILE = "config.yml"; // either absolute path or relative to bin/data
 
+const int CAM_ROTATION = -1; // clockwise quarter turns from raw sensor frames to calibrated images
+
 #define PAUSE_EXIT_FAILURE cout << "press any key to quit" << endl; std::cin.get(); ofExit(EXIT_FAILURE);
 
 //--------------------------------------------------------------
@@ -33,13 +36,128 @@ void ofApp::setup() {
 				case 2: patternType = ASYMMETRIC_CIRCLES_GRID; break;
 			}
 			calibration.setPatternType(patternType);
+			calibration.setSearchSize(settings["searchSize"]);	// 0 / missing = full res board search
+		}
+
+		bLazyFeatures = (int)settings["lazyFeatures"];	// parse per-view feature data only when needed
+
+		maxSkewMs = settings["maxSkewMs"].empty() ? 5.f : (float)settings["maxSkewMs"];	// stereo pair timestamp tolerance
+
+		// capture pixel format - Mono8 / Bayer** run detection, rectification and depth on a single channel
+		pixelFormat = settings["pixelFormat"].empty() ? "RGB8" : (string)settings["pixelFormat"];
+		if (pixelFormat == "Mono8") {
+			pixelMode = PIXELS_MONO;
+		}
+		else if (pixelFormat.find("Bayer") == 0) {
+			// OpenCV names bayer patterns one pixel diagonally in from GenICam's
+			pixelMode = PIXELS_BAYER;
+			if (pixelFormat == "BayerRG8") { bayerToGray = COLOR_BayerBG2GRAY; bayerToRgb = COLOR_BayerBG2RGB; }
+			else if (pixelFormat == "BayerGR8") { bayerToGray = COLOR_BayerGB2GRAY; bayerToRgb = COLOR_BayerGB2RGB; }
+			else if (pixelFormat == "BayerGB8") { bayerToGray = COLOR_BayerGR2GRAY; bayerToRgb = COLOR_BayerGR2RGB; }
+			else if (pixelFormat == "BayerBG8") { bayerToGray = COLOR_BayerRG2GRAY; bayerToRgb = COLOR_BayerRG2RGB; }
+			else {
+				ofLogError() << "unsupported bayer pixel format " << pixelFormat << ", using RGB8";
+				pixelMode = PIXELS_RGB;
+				pixelFormat = "RGB8";
+			}
+		}
+		else {
+			pixelMode = PIXELS_RGB;
+		}
+
+		// camera source - "vimba", "synthetic" (rendered board, known calibration) or "replay" (a recording)
+		string camera = settings["camera"].empty() ? "vimba" : (string)settings["camera"];
+		cameraMode = camera == "synthetic" ? CAMERA_SYNTHETIC : camera == "replay" ? CAMERA_REPLAY : CAMERA_VIMBA;
+		if (cameraMode == CAMERA_SYNTHETIC) {
+			syntheticSettings.patternSize = calibrations[0].getPatternSize();
+			syntheticSettings.squareSize = calibrations[0].getSquareSize();
+			syntheticSettings.channels = pixelMode == PIXELS_RGB ? 3 : 1;
+			syntheticSettings.nClockwiseRotations = -CAM_ROTATION;
+			SyntheticStereo::readSettings(settings["synthetic"], syntheticSettings);
+		}
+		replayFile = settings["replayFile"].empty() ? "" : (string)settings["replayFile"];	// empty = newest in /data/recordings/
+		bReplayRealtime = settings["replayRealtime"].empty() || (int)settings["replayRealtime"];	// 0 = as fast as the pipeline runs
+		bReplayLoop = settings["replayLoop"].empty() || (int)settings["replayLoop"];
+		bColorPreview = (int)settings["colorPreview"];
+		bLiveCalibration = (int)settings["liveCalibration"];	// re-solve calibration on every accepted pair
+		bCoverageFilter = settings["coverageFilter"].empty() || (int)settings["coverageFilter"];	// only keep pairs showing a new board pose
+		bTrimBeforeCalibration = (int)settings["trimBeforeCalibration"];
+
+		// stereo calibration drops views with a larger reprojection error and re-solves, 0 = keep all
+		StereoSolver::Settings solverSettings;
+		solverSettings.maxViewError = settings["maxViewError"].empty() ? 0. : (double)settings["maxViewError"];
+		stereoSolver.setup(solverSettings);
+
+		// dense depth - matcher, disparity search range, ROI in rectified image coords ([x, y, w, h], empty = whole frame)
+		depthSettings.bSemiGlobal = settings["depthMatcher"].empty() || (string)settings["depthMatcher"] != "bm";
+		if (!settings["minDisparity"].empty()) depthSettings.minDisparity = settings["minDisparity"];
+		if (!settings["numDisparities"].empty()) depthSettings.numDisparities = settings["numDisparities"];
+		if (!settings["blockSize"].empty()) depthSettings.blockSize = settings["blockSize"];
+		FileNode roi = settings["depthRoi"];
+		if (roi.isSeq() && roi.size() == 4) {
+			depthSettings.roi = cv::Rect((int)roi[0], (int)roi[1], (int)roi[2], (int)roi[3]);
+		}
+
+		// point cloud voxel grid decimation, in calibration units (0 = every valid pixel)
+		if (!settings["voxelSize"].empty()) pointCloud.setVoxelSize(settings["voxelSize"]);
+		bCloudColor = settings["cloudColor"].empty() || (int)settings["cloudColor"];
+
+		// ROI rectification - full frames only every roiPreviewInterval frames when just parts of them are used
+		bRoiRectification = settings["roiRectification"].empty() || (int)settings["roiRectification"];
+		if (!settings["roiPreviewInterval"].empty()) previewInterval = max(1, (int)settings["roiPreviewInterval"]);
+		FileNode rectRoi = settings["rectifyRoi"];
+		if (rectRoi.isSeq() && rectRoi.size() == 4) {
+			workRoi = cv::Rect((int)rectRoi[0], (int)rectRoi[1], (int)rectRoi[2], (int)rectRoi[3]);
+		}
+
+		// face depth - detect in the left view and search the right one along the epipolar lines
+		bEpipolarFaces = settings["epipolarFaces"].empty() || (int)settings["epipolarFaces"];
+		if (!settings["faceMaxDisparity"].empty()) faceMaxDisparity = settings["faceMaxDisparity"];
+
+		// stage timing overlay, 'O' toggles
+		bProfilerOverlay = (int)settings["profilerOverlay"];
+
+		// stereo calibration strategies to compare, ranked on held-out views
+		bEvaluateStrategies = (int)settings["evaluateStrategies"];
+		calibStrategy.name = "fixed intrinsics";
+		FileNode strategies = settings["calibStrategies"];
+		for (auto it = strategies.begin(); it != strategies.end(); ++it) {
+			StereoSolver::Strategy strategy;
+			strategy.name = (string)(*it)["name"];
+			strategy.flags = StereoSolver::parseFlags((string)(*it)["flags"]);
+			strategy.rectifyFlags = StereoSolver::parseRectifyFlags((string)(*it)["rectify"]);
+			strategy.alpha = (*it)["alpha"].empty() ? -1. : (double)(*it)["alpha"];
+			calibStrategies.push_back(strategy);
+		}
+
+		// strategy in use until an evaluation picks other calibration flags, its rectification is kept
+		// when the winner has the same flags (the only way to choose between those, they aren't ranked)
+		if (!settings["calibStrategy"].empty()) {
+			string name = settings["calibStrategy"];
+			auto it = find_if(calibStrategies.begin(), calibStrategies.end(), [&](const StereoSolver::Strategy& s) { return s.name == name; });
+			if (it != calibStrategies.end()) calibStrategy = *it;
+			else ofLogError() << "no calibration strategy " << name << " in " << CONFIG_FILE << ", using " << calibStrategy.name;
 		}
+
+		// saved calibration images: jpg, png or raw (uncompressed ppm / pgm)
+		imageWriter.setFormat(settings["imageFormat"].empty() ? "jpg" : (string)settings["imageFormat"],
+			settings["jpegQuality"].empty() ? 95 : (int)settings["jpegQuality"]);
 	}
 	else {
 		cout << "No config file found at: " << ofToDataPath(CONFIG_FILE, true);
 		PAUSE_EXIT_FAILURE;
 	}
 
+	boardFinder.setup(calibrations[0], calibrations[1]);
+	boardFinder.start();
+
+	imageWriter.setup(2, 8);
+
+	coverage.setup(calibrations[0].getPatternSize());
+
+	liveCalibrator.setup(calibrations[0]);
+	liveCalibrator.start();
+
 
 
 
@@ -50,9 +168,47 @@ void ofApp::setup() {
 
 	//auto camIds = ofxVimba::listDevices();
 
-	bool bHasCams =
-		cams[0].open(camIds[0])
-		&& cams[1].open(camIds[1]);
+	bool bHasCams;
+	if (cameraMode == CAMERA_SYNTHETIC) {
+		bHasCams = synthetic.setup(syntheticSettings);
+		sources[0] = &synthetic.getCamera(0);
+		sources[1] = &synthetic.getCamera(1);
+	}
+	else if (cameraMode == CAMERA_REPLAY) {
+		if (replayFile.empty()) {
+			// recordings are named by time, the last one is the newest
+			ofDirectory dir("recordings");
+			dir.allowExt("strec");
+			if (dir.exists()) dir.listDir();
+			dir.sort();
+			if (dir.size() > 0) replayFile = dir.getPath(dir.size() - 1);
+		}
+		bHasCams = !replayFile.empty() && replay.open(ofToDataPath(replayFile, true));
+		if (bHasCams) {
+			if ((int)replay.getHeader().channels[0] != (pixelMode == PIXELS_RGB ? 3 : 1)) {
+				ofLogError() << "recording has " << replay.getHeader().channels[0] << " channel frames, pixelFormat in " << CONFIG_FILE << " doesn't match";
+				bHasCams = false;
+			}
+			if (replay.getHeader().rotation != CAM_ROTATION) {
+				ofLogError() << "recording was made for a sensor rotation of " << replay.getHeader().rotation << ", the app uses " << CAM_ROTATION;
+				bHasCams = false;
+			}
+			replay.setRealtime(bReplayRealtime);
+			replay.setLoop(bReplayLoop);
+		}
+		else {
+			ofLogError() << "no recording to replay" << (replayFile.empty() ? " in /data/recordings/" : " at " + replayFile);
+		}
+		sources[0] = &replay.getSource(0);
+		sources[1] = &replay.getSource(1);
+	}
+	else {
+		bHasCams =
+			vimbaCams[0].open(camIds[0], pixelFormat)	// sets the camera's PixelFormat, so the link carries mono / bayer
+			&& vimbaCams[1].open(camIds[1], pixelFormat);
+		sources[0] = &vimbaCams[0];
+		sources[1] = &vimbaCams[1];
+	}
 
 
 	if (!bHasCams) {
@@ -60,12 +216,16 @@ void ofApp::setup() {
 	}
 	else {
 		for (int i = 0; i < 2; i++) {
-			imgs[i].allocate(cams[i].getCamWidth(), cams[i].getCamHeight(), OF_IMAGE_COLOR); // RGB24, ofxVimba default
+			imgs[i].allocate(sources[i]->getWidth(), sources[i]->getHeight(), pixelMode == PIXELS_RGB ? OF_IMAGE_COLOR : OF_IMAGE_GRAYSCALE);
 			undImgs[i] = imgs[i];
 		}
+
+		// one capture thread per cam, paired by timestamp
+		capture.setup(*sources[0], *sources[1]);
+		capture.setMaxSkew(uint64_t(maxSkewMs * 1000));
+		capture.start();
 	}
 
-	//ofSetLogLevel("ofxVimbaCam", OF_LOG_ERROR);
 
 
 
@@ -89,7 +249,7 @@ void ofApp::setup() {
 	for (auto& finder : finders) {
 		finder.setup("haarcascade_frontalface_default.xml");
 		finder.setPreset(ObjectFinder::Fast);
-		finder.setFindBiggestObject(true); // ??
+		finder.setFindBiggestObject(!bEpipolarFaces); // epipolar matching handles several faces
 	}
 	bFaceDepth = false;
 	bHasFace = false;
@@ -98,41 +258,144 @@ void ofApp::setup() {
 //--------------------------------------------------------------
 void ofApp::update() {
 
+	PROFILE_SCOPE("update");
+
 	float t = ofGetElapsedTimef();
 
-	// update vimba cams
+	// stereo pairs from the capture threads
 
-	for (int i = 0; i < 2; i++) {
-		cams[i].update();
+	bool bNewFrame;
+	{
+		PROFILE_SCOPE("capture");
+		bNewFrame = capture.update();
+	}
 
-		if (cams[i].isFrameNew()) {
+	if (bNewFrame && recorder.isRecording()) {
+		recorder.write(capture.getFrameRef(0), capture.getFrameRef(1), capture.getTimestamp(0), capture.getTimestamp(1));	// raw, before rotate90
+	}
+	if (cameraMode == CAMERA_REPLAY) {
+		if (bNewFrame) replay.setConsumed(capture.getTimestamp(0));	// paces replay when not real time
+		replay.update();
+	}
+
+	if (bNewFrame) {
+
+		// parts of the rectified frames this frame's consumers need, none = whole frames
+		// (face tracking, the depth map's input and / or the configured work region;
+		// face detection looks at whole frames)
+		vector<cv::Rect> rectRois[2];
+		bool bFullFrame = !bRectify || !bRoiRectification || bSearching
+			|| (bFaceDepth && (!bEpipolarFaces || faceMatcher.willDetect()))
+			|| ++previewCount >= previewInterval;
+		if (bFullFrame) {
+			previewCount = 0;
+		}
+		else {
+			if (bFaceDepth) {
+				faceMatcher.getRois(rectRois[0], rectRois[1], rectifiers[0].getSize());
+			}
+			if (bDepthMap && depthMapper.isSetup()) {
+				cv::Rect depthRoi = depthMapper.getInputRoi(rectifiers[0].getSize());
+				rectRois[0].push_back(depthRoi);
+				rectRois[1].push_back(depthRoi);
+			}
+			if (workRoi.area() > 0) {
+				rectRois[0].push_back(workRoi);
+				rectRois[1].push_back(workRoi);
+			}
+		}
+		size_t nRectified = 0;
 
-			// copy, rotate
-			imgs[i] = cams[i].getFrame();
-			imgs[i].rotate90(-1);
+		for (int i = 0; i < 2; i++) {
 
-			if (bUndistort && !bRectify) {  // undistort only
-				imitate(undImgs[i], imgs[i]);
-				calibrations[i].undistort(toCv(imgs[i]), toCv(undImgs[i]));
-				undImgs[i].update();
+			const auto& raw = capture.getFrame(i);
+			const auto& frame = workingFrame(i, raw);	// single channel unless capturing RGB
+
+			if (bColorPreview && pixelMode == PIXELS_BAYER) {
+				updateColorPreview(i, raw);
 			}
-			else if (bRectify) {
-				imitate(undImgs[i], imgs[i]);
-				cv::remap(toCv(imgs[i]), toCv(undImgs[i]), mapX[i], mapY[i], cv::INTER_LINEAR);
-				undImgs[i].update();
 
-				// face detection
-				if (bFaceDepth) {	// only runs if rectification is on
+			if (bRectify) {
+				PROFILE_SCOPE("rectify");
+				// raw frame -> rotated + rectified in one remap
+				if (rectRois[i].empty()) {
+					rectifiers[i].rectify(frame, undImgs[i].getPixels());
+					undImgs[i].update();
+					nRectified += undImgs[i].getPixels().getWidth() * undImgs[i].getPixels().getHeight();
+				}
+				else {
+					// just the rois, the texture keeps the last full frame
+					for (auto& roi : rectRois[i]) {
+						nRectified += rectifiers[i].rectify(frame, undImgs[i].getPixels(), roi);
+					}
+				}
+			}
 
-					finders[i].update(undImgs[i]);
+			// face detection
+			if (bRectify && bFaceDepth && !bEpipolarFaces) {	// only runs if rectification is on
+				PROFILE_SCOPE("face detection");
+				finders[i].update(undImgs[i]);
+			}
+
+			if (!bRectify || bSearching) {	// rectified view doesn't need the rotated copy
+
+				// rotate into the existing buffer
+				{
+					PROFILE_SCOPE("rotate");
+					frame.rotate90To(imgs[i].getPixels(), CAM_ROTATION);
+					imgs[i].update();
 				}
 
+				if (bUndistort && !bRectify) {  // undistort only
+					PROFILE_SCOPE("undistort");
+					imitate(undImgs[i], imgs[i]);
+					calibrations[i].undistort(toCv(imgs[i]), toCv(undImgs[i]));
+					undImgs[i].update();
+				}
 			}
 
 		}
+
+		if (bRectify) {
+			cv::Size size = rectifiers[0].getSize();
+			rectifiedFraction = nRectified / float(2 * size.area());	// overlapping rois count twice
+		}
+
+		// faces: left view detection / tracking, right view along the epipolar band
+		if (bFaceDepth && bEpipolarFaces && bRectify) {
+			PROFILE_SCOPE("face matching");
+			faceMatcher.update(undImgs[0].getPixels(), undImgs[1].getPixels(), finders[0], rectRois[0].empty());
+		}
+	}
+
+	// dense depth
+	if (bNewFrame && bDepthMap && bRectify && depthMapper.isSetup()) {
+		{
+			PROFILE_SCOPE("depth");
+			depthMapper.compute(undImgs[0].getPixels(), undImgs[1].getPixels());
+			depthMapper.getDisparityPixels(disparityImg.getPixels());
+			disparityImg.update();
+		}
+
+		if (cloudStream.isOpen()) {
+			PROFILE_SCOPE("point cloud");
+			pointCloud.compute(depthMapper.getDisparity(), depthMapper.getRoi(), depthSettings.minDisparity,
+				bCloudColor ? &undImgs[0].getPixels() : nullptr, capture.getTimestamp(0));
+			cloudStream.push(pointCloud);
+		}
 	}
 
-	if (bFaceDepth) {
+	if (bFaceDepth && bEpipolarFaces) {
+		// first face for the single face depth, all of them are drawn
+		auto& matched = faceMatcher.getFaces();
+		bHasFace = !matched.empty();
+		if (bHasFace) {
+			faces[0] = matched[0].left;
+			faces[1] = matched[0].right;
+			faceDepth = matched[0].depth;
+		}
+	}
+	else if (bFaceDepth) {
 	// face detection check
 		if (finders[0].size() == 1 && finders[1].size() == 1) {	// both views see a single face, we assume the same one...
 			bHasFace = true;
@@ -163,33 +426,91 @@ void ofApp::update() {
 	}
 
 
-	// calibration pattern search
+	// pairs loaded from disk ('C'), as they finish
+	CaptureStore::Pair loaded;
+	bool bLoaded = false;
+	while (pairLoader.poll(loaded)) {
+		coverage.add(captures.add(std::move(loaded)));
+		bLoaded = true;
+	}
+	if (bLoaded && bLiveCalibration) postLiveCalibration();
+
+	// live calibration estimates
+
+	LiveCalibrator::Estimate estimate;
+	if (liveCalibrator.poll(estimate)) {
+		if (liveEstimate.nPairs > 0) {
+			// largest relative change of the focal lengths and baseline, terms that were 0 are skipped
+			double before[3] = { liveEstimate.K[0].at<double>(0, 0), liveEstimate.K[1].at<double>(0, 0), norm(liveEstimate.T) };
+			double after[3] = { estimate.K[0].at<double>(0, 0), estimate.K[1].at<double>(0, 0), norm(estimate.T) };
+			liveChange = 0;
+			for (int k = 0; k < 3; k++) {
+				if (before[k] != 0) liveChange = max(liveChange, abs(after[k] - before[k]) / abs(before[k]));
+			}
+		}
+		liveEstimate = std::move(estimate);
+	}
+
+	// calibration pattern search - runs on boardFinder's thread, results are picked up here
+
+	BoardFinder::Result result;
+	bool bResult = boardFinder.poll(result);
 
 	if (bSearching && t - foundTime > waitTime) {
 
-		Mat mats[2];
-		mats[0] = toCv(imgs[0]);
-		mats[1] = toCv(imgs[1]);
+		PROFILE_SCOPE("board post + save");	// main thread side only, the search is "findBoard (thread)"
 
-		std::vector<cv::Point2f> pointBufs[2];
+		if (bNewFrame) {
+			boardFinder.post(imgs[0].getPixels(), imgs[1].getPixels());	// replaces a pair still waiting
+		}
 
-		// find corners
-		bFound = calibrations[0].findBoard(mats[0], pointBufs[0]) && calibrations[1].findBoard(mats[1], pointBufs[1]);
+		bool bSave = bResult && result.bFound;
 
-		if (bFound) {
+		// board pose already covered - not worth a view, keep searching
+		if (bSave && bCoverageFilter) {
+			CaptureStore::Pair candidate;
+			for (int i = 0; i < 2; i++) {
+				candidate.views[i].corners = result.corners[i];
+				candidate.views[i].imageSize = cv::Size(result.pix[i]->getWidth(), result.pix[i]->getHeight());
+			}
+			if (!coverage.addsCoverage(candidate)) {
+				nRedundant++;
+				bSave = false;
+			}
+		}
+
+		// writer backed up - drop the pair rather than keep one that isn't on disk, search retries next frame
+		if (bSave && !imageWriter.canWrite(2)) {
+			ofLogWarning() << "image writer busy (" << imageWriter.getNumQueued() << " queued), skipping pair";
+			bSave = false;
+		}
+
+		// shown until the next search result, not just until waitTime runs out
+		if (bResult) bFound = bSave;
+
+		if (bSave) {
 
 			// save images
 
 			//string dir = ofToDataPath("cal_imgs", false);
-			string fn0 = ofFilePath::join("cal_imgs", "/L/L_" + ofToString(foundImgs.size()) + ".jpg");
-			string fn1 = ofFilePath::join("cal_imgs", "/R/R_" + ofToString(foundImgs.size()) + ".jpg");
+			string ext = "." + imageWriter.getExtension(result.pix[0]->getNumChannels());
+			string fn0 = ofFilePath::join("cal_imgs", "/L/L_" + ofToString(nextSaveIndex) + ext);
+			string fn1 = ofFilePath::join("cal_imgs", "/R/R_" + ofToString(nextSaveIndex) + ext);
 
 			ofLogNotice() << "found checkerboard, saving to " << fn0 << " and " << fn1;
 
-			ofSaveImage(imgs[0].getPixelsRef(), fn0);
-			ofSaveImage(imgs[1].getPixelsRef(), fn1);
+			imageWriter.write(result.pix[0], fn0);
+			imageWriter.write(result.pix[1], fn1);
 
-			foundImgs.emplace_back(imgs[0], imgs[1]);
+			// only corners + a thumbnail stay in memory, corners are reused by calibrateIntrinsics()
+			auto& found = captures.add(*result.pix[0], *result.pix[1], fn0, fn1, std::move(result.corners[0]), std::move(result.corners[1]));
+			for (int i = 0; i < 2; i++) {
+				lastThumbs[i].setFromPixels(found.views[i].thumb);
+			}
+			coverage.add(found);
+			nextSaveIndex++;
+
+			if (bLiveCalibration) postLiveCalibration();
 
 			foundTime = ofGetElapsedTimef();
 
@@ -203,28 +524,105 @@ void ofApp::update() {
 
 }
 
+//--------------------------------------------------------------
+const ofPixels& ofApp::workingFrame(int i, const ofPixels& raw)
+{
+	// luminance for the processing pipeline, raw frame orientation
+
+	if (pixelMode == PIXELS_RGB || (pixelMode == PIXELS_MONO && raw.getNumChannels() == 1)) {
+		return raw;
+	}
+
+	PROFILE_SCOPE("luma");
+
+	Mat src = toCv(const_cast<ofPixels&>(raw));
+	lumaFrames[i].allocate(raw.getWidth(), raw.getHeight(), 1);
+	Mat dst = toCv(lumaFrames[i]);
+
+	if (raw.getNumChannels() == 1) {
+		cvtColor(src, dst, bayerToGray);
+	}
+	else {
+		cvtColor(src, dst, raw.getNumChannels() == 4 ? COLOR_RGBA2GRAY : COLOR_RGB2GRAY);	// camera still sends colour
+	}
+	return lumaFrames[i];
+}
+
+//--------------------------------------------------------------
+void ofApp::updateColorPreview(int i, const ofPixels& raw)
+{
+	// display only: debayer and put the colour frame through the same geometry as the working frame
+
+	if (raw.getNumChannels() != 1) return;
+
+	PROFILE_SCOPE("colour preview");
+
+	colorFrames[i].allocate(raw.getWidth(), raw.getHeight(), 3);
+	Mat dst = toCv(colorFrames[i]);
+	cvtColor(toCv(const_cast<ofPixels&>(raw)), dst, bayerToRgb);
+
+	if (bRectify) {
+		rectifiers[i].rectify(colorFrames[i], previewImgs[i].getPixels());
+	}
+	else if (bUndistort) {
+		colorFrames[i].rotate90To(colorRotated[i], CAM_ROTATION);
+		previewImgs[i].getPixels().allocate(colorRotated[i].getWidth(), colorRotated[i].getHeight(), 3);
+		calibrations[i].undistort(toCv(colorRotated[i]), toCv(previewImgs[i].getPixels()));
+	}
+	else {
+		colorFrames[i].rotate90To(previewImgs[i].getPixels(), CAM_ROTATION);
+	}
+	previewImgs[i].update();
+}
+
 //--------------------------------------------------------------
 void ofApp::draw() {
 
+	PROFILE_SCOPE("draw");
+
 	float x = 0;
 	float y = 0;
 	float w = ofGetWidth() / float(2);
 	float h = 0;
 
+	bool bPreview = bColorPreview && pixelMode == PIXELS_BAYER && previewImgs[0].isAllocated() && previewImgs[1].isAllocated();
+
 	if (!bUndistort && !bRectify) {
-		for (auto& img : imgs) {
+		for (auto& img : (bPreview ? previewImgs : imgs)) {
 			h = w / img.getWidth() * img.getHeight();
 			img.draw(x, y, w, h);
 			x += w;
 		}
 	}
 	else {
-		for (auto& img : undImgs) {
+		for (auto& img : (bPreview ? previewImgs : undImgs)) {
 			h = w / img.getWidth() * img.getHeight();
 			img.draw(x, y, w, h);
 			x += w;
 		}
-		if (bHasFace) {
+		if (bDepthMap && disparityImg.isAllocated()) {
+			disparityImg.draw(w, 0, w, h);	// in place of the right view
+		}
+		if (bHasFace && bEpipolarFaces) {
+
+			// draw face boxes, every face with its own depth
+			ofPushMatrix();
+			ofPushStyle();
+			ofNoFill();
+			ofScale(w / undImgs[0].getWidth());
+
+			for (auto& face : faceMatcher.getFaces()) {
+				ofDrawRectangle(face.left);
+				ofDrawBitmapStringHighlight(ofToString(face.depth, 1), face.left.getCenter());
+				if (face.depth > 0) {
+					ofDrawRectangle(face.right + glm::vec3(undImgs[0].getWidth(), 0, 0));
+				}
+			}
+
+			ofPopStyle();
+			ofPopMatrix();
+		}
+		else if (bHasFace) {
 
 			// draw face boxes
 			ofPushMatrix();
@@ -247,19 +645,29 @@ void ofApp::draw() {
 
 		}
 	}
+
+	// last saved pair
+	if (bSearching && lastThumbs[0].isAllocated() && lastThumbs[1].isAllocated()) {
+		float tx = ofGetWidth() - lastThumbs[0].getWidth() - lastThumbs[1].getWidth() - 20;
+		lastThumbs[0].draw(tx, h + 10);
+		lastThumbs[1].draw(tx + lastThumbs[0].getWidth() + 10, h + 10);
+	}
 	
 
 	stringstream ss;
 	ss << "Press SPACE to turn " << (bSearching ? "OFF" : "ON") << " checkerboard search.";
+	if (pairLoader.isLoading()) {
+		ss << "\nLoading ./data/cal_imgs/ - " << pairLoader.getNumDone() << " / " << pairLoader.getNumTotal() << " pairs, board found in " << pairLoader.getNumFound();
+	}
 	if (bSearching) {
-		ss << "\nSearching... saved " << ofToString(foundImgs.size(), 3, ' ') << " frames so far...";
+		ss << "\nSearching... saved " << ofToString(captures.size(), 3, ' ') << " frames so far...";
 		if (bFound) {
 			ss << "\tFOUND board - Searching again in " << ofToString(max(0.f, waitTime - (ofGetElapsedTimef() - foundTime)),2) << " sec";
 		}
 	}
 	if (!bSearching){
-		if (foundImgs.size()) {
-			ss << "\nPress ENTER to run full calibration on " << foundImgs.size() << " saved frames" << (bHasIntrinsics && bHasExtrinsics ? " - DONE" : "");
+		if (captures.size()) {
+			ss << "\nPress ENTER to run full calibration on " << captures.size() << " saved frames" << (bHasIntrinsics && bHasExtrinsics ? " - DONE" : "");
 			ss << "\nPress DELETE to clear saved frames from memory and reset calibration";
 		}
 		else {
@@ -269,46 +677,134 @@ void ofApp::draw() {
 
 	ss << "\n'L' - load calibration files from disk";
 	if (bHasExtrinsics) ss << "\n'F' - track face and calc depth based on calibration.";
+	if (bFaceDepth && bEpipolarFaces) ss << " " << faceMatcher.getFaces().size() << " faces" << (faceMatcher.didDetect() ? " (detecting)" : " (tracking)");
+	if (bHasExtrinsics) {
+		ss << "\n'D' - toggle dense depth map - " << (bDepthMap ? "ON" : "OFF");
+		if (bDepthMap) {
+			ss << " (" << (depthSettings.bSemiGlobal ? "SGBM" : "BM") << ", " << ofToString(depthMapper.getComputeMs(), 1) << " ms)";
+			ss << "\n'X' - export point cloud (.ply)";
+			ss << "\n'K' - toggle point cloud recording - " << (cloudStream.isOpen() ? "ON" : "OFF");
+			if (cloudStream.isOpen()) {
+				ss << " (" << pointCloud.size() << " points, " << ofToString(pointCloud.getComputeMs(), 1) << " ms, "
+					<< cloudStream.getNumWritten() << " frames, " << cloudStream.getBytesWritten() / (1024 * 1024) << " MB, dropped " << cloudStream.getNumDropped() << ")";
+			}
+			// depth under the mouse, left view
+			if (undImgs[0].isAllocated() && ofGetMouseX() < w) {
+				float scale = undImgs[0].getWidth() / w;
+				ss << " - depth at mouse: " << ofToString(depthMapper.getDepth(ofGetMouseX() * scale, ofGetMouseY() * scale), 2);
+			}
+		}
+	}
 	ofDrawBitmapStringHighlight(ss.str(), 10, h + 20);
 
 	stringstream ssa; // advanced
 
 	ssa << "Advanced:";
 	ssa << "\n'C' - load checkerboard images from disk ( /data/cal_imgs/L/ + /data/cal_imgs/R/ )";
-	ssa << "\n'I' - perform intrinsic calibration on " << foundImgs.size() << " frames" << (bHasIntrinsics ? " - DONE" : "");
+	ssa << "\n'I' - perform intrinsic calibration on " << captures.size() << " frames" << (bHasIntrinsics ? " - DONE" : "");
 	ssa << "\n'E' - perform stereo (extrinsic) calibration based on intrinsic calibration";
+	if (bHasExtrinsics && !viewErrors.empty()) ssa << " - rms " << ofToString(stereoRms, 3) << " px, " << droppedViews.size() << " outlier views dropped";
 	ssa << "\n'U' - toggle undistortion - " << (bUndistort || bRectify ? "ON" : "OFF");
 	ssa << "\n'R' - toggle rectification based on stereo calibration - " << (bRectify ? "ON" : "OFF");
+	if (pixelMode == PIXELS_BAYER) ssa << "\n'P' - toggle colour preview (debayered for display only) - " << (bColorPreview ? "ON" : "OFF");
+	ssa << "\n'B' - benchmark coarse-to-fine board search against full res on /data/cal_imgs/ images (see log)";
+	ssa << "\n'S' - toggle comparing " << calibStrategies.size() << " calibration strategies on stereo calibration - " << (bEvaluateStrategies ? "ON" : "OFF")
+		<< " (using: " << calibStrategy.name << ")";
+	ssa << "\n'V' - toggle pose coverage filter for the search - " << (bCoverageFilter ? "ON" : "OFF")
+		<< " (" << coverage.getNumCovered() << " poses covered, " << nRedundant << " redundant pairs skipped)";
+	ssa << "\n'T' - trim saved frames to a minimal set covering the same poses";
+#if PROFILING
+	ssa << "\n'O' - toggle stage timing overlay - " << (bProfilerOverlay ? "ON" : "OFF");
+	ssa << "\n'W' - write stage timings to /data/profiles/ (.csv histograms + .json chrome trace)";
+#endif
+	ssa << "\n'M' - record raw stereo pairs to /data/recordings/ - " << (recorder.isRecording() ? "RECORDING" : "OFF");
+	if (cameraMode == CAMERA_REPLAY) ssa << "\nLEFT / RIGHT - seek replay -+5 sec, HOME - restart, END - toggle real time / as fast as possible";
+	ssa << "\n'A' - toggle live calibration on every saved pair - " << (bLiveCalibration ? "ON" : "OFF");
+	if (bLiveCalibration) {
+		if (liveEstimate.nPairs > 0) {
+			ssa << "\n    " << liveEstimate.nPairs << " pairs, " << ofToString(liveEstimate.solveMs, 0) << " ms" << (liveCalibrator.isBusy() ? " (solving)" : "")
+				<< " - rms L: " << ofToString(liveEstimate.rms[0], 3) << ", R: " << ofToString(liveEstimate.rms[1], 3) << ", stereo: " << ofToString(liveEstimate.stereoRms, 3) << " px"
+				<< ", change: " << ofToString(liveChange * 100, 2) << "%";
+			for (int i = 0; i < 2; i++) {
+				ssa << "\n    " << (i == 0 ? "L" : "R") << " fx " << ofToString(liveEstimate.K[i].at<double>(0, 0), 1) << " +-" << ofToString(liveEstimate.stdDev[i][0], 2)
+					<< ", fy " << ofToString(liveEstimate.K[i].at<double>(1, 1), 1) << " +-" << ofToString(liveEstimate.stdDev[i][1], 2)
+					<< ", cx " << ofToString(liveEstimate.K[i].at<double>(0, 2), 1) << " +-" << ofToString(liveEstimate.stdDev[i][2], 2)
+					<< ", cy " << ofToString(liveEstimate.K[i].at<double>(1, 2), 1) << " +-" << ofToString(liveEstimate.stdDev[i][3], 2);
+			}
+			ssa << "\n    baseline " << ofToString(norm(liveEstimate.T), 2);
+		}
+		else {
+			ssa << "\n    waiting for " << liveCalibrator.getMinPairs() << " pairs with the board in both views" << (liveCalibrator.isBusy() ? " (solving)" : "");
+		}
+	}
+	ssa << "\n\ncapture - " << (cameraMode == CAMERA_SYNTHETIC ? "synthetic" : cameraMode == CAMERA_REPLAY ? "replay" : "vimba") << " pairs: " << capture.getNumPaired() << ", skew: " << capture.getSkew() / 1000. << " ms"
+		<< ", dropped: " << capture.getNumDropped(0) << "/" << capture.getNumDropped(1)
+		<< ", late: " << capture.getNumLate() << ", unpaired: " << capture.getNumUnpaired();
+	if (recorder.isRecording()) ssa << "\nrecording - " << recorder.getNumWritten() << " pairs, " << recorder.getBytesWritten() / (1024 * 1024) << " MiB, dropped " << recorder.getNumDropped();
+	if (cameraMode == CAMERA_REPLAY && replay.isOpen()) ssa << "\nreplay - frame " << min(replay.getPosition(), replay.getNumFrames()) << " / " << replay.getNumFrames()
+		<< ", " << (replay.getRealtime() ? "real time" : "as fast as possible") << (replay.getLoop() ? ", looping" : "")
+		<< (replay.getNumUnmatched() ? ", skipped " + ofToString(replay.getNumUnmatched()) + " unpaired frames" : "");
+	if (bRectify) ssa << "\nrectified " << ofToString(rectifiedFraction * 100, 1) << "% of the frames" << (bRoiRectification ? ", full frame every " + ofToString(previewInterval) + " frames" : "");
+	ssa << "\nframe buffer allocations - capture: " << capture.getNumAllocations() << ", search: " << boardFinder.getNumAllocations();
+	ssa << "\ncapture store - " << captures.size() << " pairs, " << ofToString(captures.getMemoryBytes() / 1024.f, 1) << " KB in memory";
+	ssa << "\nimage writer (" << imageWriter.getFormat() << ") - queued: " << imageWriter.getNumQueued() << ", written: " << imageWriter.getNumWritten()
+		<< ", rejected: " << imageWriter.getNumRejected() << ", failed: " << imageWriter.getNumFailed();
 
 	ofDrawBitmapStringHighlight(ssa.str(), 10, h + 100, ofColor::black, ofColor::gray);
 
+#if PROFILING
+	if (bProfilerOverlay) {
+		ofDrawBitmapStringHighlight(Profiler::get().getSummary(), 10, 20, ofColor(0, 180), ofColor::white);
+	}
+#endif
 
 }
 
 //--------------------------------------------------------------
 void ofApp::exit()
 {
-	ofxVimba::exit();
+	boardFinder.stop();
+	cloudStream.close();
+	liveCalibrator.stop();
+	pairLoader.stop();
+	imageWriter.stop();	// writes whatever is still queued
+	recorder.stop();	// writes the pairs still queued
+	capture.stop();
+	for (auto& cam : vimbaCams) cam.close();
 }
 
 
 //--------------------------------------------------------------
 bool ofApp::calibrateIntrinsics()
 {
+	PROFILE_SCOPE("calibrateIntrinsics");
+
 	auto& cal0 = calibrations[0];
 	auto& cal1 = calibrations[1];
 
-	cal0.reset();
-	cal1.reset();
+	cal0.resetCalibration();
+	cal1.resetCalibration();
 
-	for (int i = 0; i < foundImgs.size(); ++i) {
-		auto& p = foundImgs[i];
-		if (!cal0.add(toCv(p.first))) {
-			ofLogError() << "Calibration::add() failed on left img " << i;
-		}
-		if (!cal1.add(toCv(p.second))) {
-			ofLogError() << "Calibration::add() failed on right img " << i;
+	// use corners from the live search if we have them, only detect for pairs loaded from disk
+	findCorners();
+
+	// pairs go in together or not at all, so imagePoints stay index-aligned for cv::stereoCalibrate
+	int nDropped = 0;
+	vector<size_t> added;	// capture index of each calibration view
+	for (int i = 0; i < captures.size(); ++i) {
+		auto& p = captures[i];
+
+		if (p.views[0].corners.empty() || p.views[1].corners.empty()) {
+			ofLogError() << "no board found in " << (p.views[0].corners.empty() ? "left" : "right") << " img " << i << ", dropping pair";
+			nDropped++;
+			continue;
 		}
+		cal0.add(p.views[0].corners, p.views[0].imageSize);
+		cal1.add(p.views[1].corners, p.views[1].imageSize);
+		added.push_back(i);
+	}
+	if (nDropped) {
+		ofLogNotice() << "calibrating with " << cal0.size() << " of " << captures.size() << " pairs, dropped " << nDropped;
 	}
 
 	bHasIntrinsics = cal0.calibrate() && cal1.calibrate();
@@ -325,6 +821,13 @@ bool ofApp::calibrateIntrinsics()
 		// image size
 		sz = cal0.getDistortedIntrinsics().getImageSize();
 
+		// board poses per pair
+		for (size_t k = 0; k < added.size(); k++) {
+			auto& p = captures[added[k]];
+			cal0.getBoardPose(k, p.views[0].rvec, p.views[0].tvec);
+			cal1.getBoardPose(k, p.views[1].rvec, p.views[1].tvec);
+		}
+
 		// save to disk
 		string dir = ofToDataPath("cal_imgs", true);
 		calibrations[0].save(dir + "/L_calib.yml", true);
@@ -335,9 +838,86 @@ bool ofApp::calibrateIntrinsics()
 }
 
 
+//--------------------------------------------------------------
+void ofApp::findCorners()
+{
+	PROFILE_SCOPE("findCorners");
+
+	// detect corners on every image that hasn't been searched yet, one task per image
+
+	vector<pair<int, int>> tasks;	// pair index, side
+	for (int i = 0; i < captures.size(); ++i) {
+		if (captures[i].bSearched) continue;
+		tasks.emplace_back(i, 0);
+		tasks.emplace_back(i, 1);
+	}
+	if (tasks.empty()) return;
+
+	uint64_t t0 = ofGetElapsedTimeMillis();
+
+	parallelFor(0, (int)tasks.size(), [&](int k) {
+		int i = tasks[k].first;
+		int side = tasks[k].second;
+
+		// paged in from disk for the search only
+		ofPixels pix;
+		auto& corners = captures[i].views[side].corners;
+		corners.clear();
+		if (!captures.loadImage(i, side, pix)) return;
+
+		CameraCalibration cal = calibrations[side];	// own copy, findBoard() isn't thread safe
+		if (!cal.findBoardCoarseToFine(toCv(pix), corners) || (int)corners.size() != cal.getPatternSize().area()) {
+			corners.clear();
+		}
+	});
+
+	for (auto& task : tasks) {
+		captures[task.first].bSearched = true;
+	}
+
+	ofLogNotice() << "found corners on " << tasks.size() << " images in " << ofGetElapsedTimeMillis() - t0 << " ms";
+}
+
+//--------------------------------------------------------------
+void ofApp::postLiveCalibration()
+{
+	// corners of every pair with the board in both views, solved in the background
+
+	vector<vector<Point2f>> left, right;
+	cv::Size imageSize;
+	for (auto& p : captures) {
+		if (p.views[0].corners.empty() || p.views[1].corners.empty()) continue;
+		left.push_back(p.views[0].corners);
+		right.push_back(p.views[1].corners);
+		imageSize = p.views[0].imageSize;
+	}
+	liveCalibrator.post(left, right, imageSize);
+}
+
+//--------------------------------------------------------------
+void ofApp::trimCaptures()
+{
+	PROFILE_SCOPE("trimCaptures");
+
+	// drop pairs whose board poses are covered by others
+
+	findCorners();
+
+	size_t n = captures.size();
+	captures.select(coverage.selectInformative(captures));
+
+	coverage.clear();
+	for (auto& p : captures) {
+		coverage.add(p);
+	}
+
+	ofLogNotice() << "trimmed captures to " << captures.size() << " of " << n << " pairs, " << coverage.getNumCovered() << " poses covered";
+}
+
 //--------------------------------------------------------------
 bool ofApp::stereoCalibrate()
 {
+	PROFILE_SCOPE("stereoCalibrate");
 
 	if (!bHasIntrinsics) {
 		cout << "error performing stereo calibration - cameras have not been intrinsically calibrated yet" << endl;
@@ -352,6 +932,10 @@ bool ofApp::stereoCalibrate()
 	auto& cal0 = calibrations[0];
 	auto& cal1 = calibrations[1];
 
+	// feature data of a lazily loaded calibration is parsed on first use
+	cal0.loadFeatures();
+	cal1.loadFeatures();
+
 	// must be the same size and have data
 	if (cal0.size() != cal1.size() || cal0.size() == 0) {
 		cout << "error performing stereo calibration from calibration data vectors of size - [0]: " << cal0.size() << ", [1]: " << cal1.size() << endl;
@@ -359,53 +943,73 @@ bool ofApp::stereoCalibrate()
 	}
 
 	// make static object points
-	std::vector<cv::Point3f> pts = cal0.createObjectPoints(cal0.getPatternSize(), cal0.getSquareSize(), ofxCv::CalibrationPattern::CHESSBOARD);
+	std::vector<cv::Point3f> pts = cal0.createObjectPoints(cal0.getPatternSize(), cal0.getSquareSize(), cal0.getPatternType());
 	objectPoints.resize(cal0.size(), pts);
 
-	// cam matrices
-	// K0 = cal0.getDistortedIntrinsics().getCameraMatrix();
-	// K1 = cal1.getDistortedIntrinsics().getCameraMatrix();
-	
-	// distortion coefs
-	// D0 = cal0.getDistCoeffs();
-	// D1 = cal1.getDistCoeffs();
+	// try the configured strategies on the same corners concurrently, keep the best
+	if (bEvaluateStrategies && !calibStrategies.empty()) {
+		uint64_t t0 = ofGetElapsedTimeMillis();
+		auto evaluations = stereoSolver.evaluate(calibStrategies, objectPoints, cal0.imagePoints, cal1.imagePoints, K0, D0, K1, D1, sz);
 
-	// cv::Size sz = cal0.getDistortedIntrinsics().getImageSize();
-
-	// output matrices
-	// Vec3d T;		// translation
-	// Mat R, F, E;	// rotation, fundamental, essential
-
-	cv::stereoCalibrate(objectPoints, cal0.imagePoints, cal1.imagePoints, K0, D0, K1, D1, sz, R, T, E, F);
+		ofLogNotice() << "calibration strategies, best first (" << ofGetElapsedTimeMillis() - t0 << " ms):";
+		for (auto& eval : evaluations) {
+			if (eval.bOk) {
+				ofLogNotice() << "  " << eval.strategy.name << " - held-out rms " << eval.heldOutError << " px, epipolar " << eval.epipolarError << " px, training rms " << eval.rms << " px";
+			}
+			else {
+				ofLogNotice() << "  " << eval.strategy.name << " - failed";
+			}
+		}
+		if (evaluations[0].bOk && evaluations[0].strategy.flags != calibStrategy.flags) {
+			calibStrategy = evaluations[0].strategy;	// same flags keep the rectification in use
+		}
+	}
 
-	string file = ofToDataPath("cal_imgs", true) + "/stereo_calib.yml";
+	// solve, drop views over maxViewError, re-solve...
+	StereoSolver::Result result;
+	if (!stereoSolver.solve(calibStrategy.flags, objectPoints, cal0.imagePoints, cal1.imagePoints, K0, D0, K1, D1, sz, result)) {
+		return bHasExtrinsics = false;
+	}
 
-	cv::FileStorage fs(file, cv::FileStorage::WRITE);
-	fs << "K0" << K0;
-	fs << "D0" << D0;
-	fs << "K1" << K1;
-	fs << "D1" << D1;
-	fs << "R" << R;		// rotation 0->1
-	fs << "T" << T;		// translation 0->1
-	fs << "E" << E;		// essential 0->1
-	fs << "F" << F;		// fundamental 0->1
+	K0 = result.K[0];	// refined unless the strategy fixes intrinsics
+	D0 = result.D[0];
+	K1 = result.K[1];
+	D1 = result.D[1];
+	cal0.setIntrinsics(K0, D0);	// so L / R_calib.yml match stereo_calib.yml
+	cal1.setIntrinsics(K1, D1);
+	R = result.R;
+	T = (Vec3d)result.T;
+	E = result.E;
+	F = result.F;
+	stereoRms = result.rms;
+	viewErrors = result.viewErrors;
+	droppedViews = result.dropped;
+
+	ofLogNotice() << "stereo calibration rms " << stereoRms << " px, " << cal0.size() - droppedViews.size() << " of " << cal0.size() << " views"
+		<< (droppedViews.empty() ? "" : ", dropped " + ofToString(droppedViews)) << ", " << result.iterations << " solves";
+
+	if (cameraMode == CAMERA_SYNTHETIC) {
+		Mat K[2] = { K0, K1 }, D[2] = { D0, D1 };
+		ofLogNotice() << "synthetic ground truth:\n" << synthetic.compare(K, D, R, Mat(T));
+	}
 
 	//cv::Mat R0, R1, P0, P1, Q;
 	//flag = CV_CALIB_ZERO_DISPARITY;
-	int flag = 0; double alpha = -1;
+	int flag = calibStrategy.rectifyFlags; double alpha = calibStrategy.alpha;
 
 	cv::stereoRectify(K0, D0, K1, D1, cal0.getDistortedIntrinsics().getImageSize(), R, T, R0, R1, P0, P1, Q, flag, alpha);
 
-	fs << "R0" << R0;	// rotation cam 0 
-	fs << "R1" << R1;	// rotation cam 1
-	fs << "P0" << P0;	// projection cam 0
-	fs << "P1" << P1;	// projection cam 1
-	fs << "Q" << Q;		// disparity-to-depth mapping matrix
+	string file = ofToDataPath("cal_imgs", true) + "/stereo_calib.yml";
+	saveStereoCalibration(ofToDataPath("cal_imgs", true), true);
 
 	// calc rectification maps
 
-	cv::initUndistortRectifyMap(K0, D0, R0, P0, cal0.getDistortedIntrinsics().getImageSize(), CV_32F, mapX[0], mapY[0]);
-	cv::initUndistortRectifyMap(K1, D1, R1, P1, cal1.getDistortedIntrinsics().getImageSize(), CV_32F, mapX[1], mapY[1]);
+	rectifiers[0].setup(K0, D0, R0, P0, cal0.getDistortedIntrinsics().getImageSize(), CAM_ROTATION);
+	rectifiers[1].setup(K1, D1, R1, P1, cal1.getDistortedIntrinsics().getImageSize(), CAM_ROTATION);
+
+	depthMapper.setup(depthSettings, Q);
+	pointCloud.setup(Q, pointCloud.getVoxelSize());
+	faceMatcher.setup(Q, faceMaxDisparity);
 
 	cout << "Stereo calibration complete! --> " << file << endl;
 
@@ -416,6 +1020,9 @@ bool ofApp::stereoCalibrate()
 //--------------------------------------------------------------
 bool ofApp::fullCalibration()
 {
+	if (bTrimBeforeCalibration) {
+		trimCaptures();
+	}
 	bool ok = calibrateIntrinsics();
 	if (ok) {
 		ok = stereoCalibrate();
@@ -436,6 +1043,8 @@ bool ofApp::fullCalibration()
 //--------------------------------------------------------------
 bool ofApp::loadCalibration(string dir, bool absolute)
 {
+	PROFILE_SCOPE("loadCalibration");
+
 	// load calibration files from disk
 
 	if (!absolute) dir = ofToDataPath(dir, true);
@@ -458,10 +1067,23 @@ bool ofApp::loadCalibration(string dir, bool absolute)
 
 	ofLogNotice() << "loading: " << calLPath << ", " << calRPath << ", " << calSPath;
 
+	// fast path - mmap'ed binary bundle with precomputed rectification maps
+
+	if (loadCalibrationBundle(dir)) {
+		return true;
+	}
+	ofLogWarning() << "couldn't use calibration bundle, loading from YAML";
+
 
 	// instrinsic calibrations
-	calibrations[0].load(calLPath, true);
-	calibrations[1].load(calRPath, true);
+	if (bLazyFeatures) {
+		calibrations[0].loadLazy(calLPath, true);
+		calibrations[1].loadLazy(calRPath, true);
+	}
+	else {
+		calibrations[0].load(calLPath, true);
+		calibrations[1].load(calRPath, true);
+	}
 
 	ofLogNotice() << "loaded instrinsics";
 
@@ -470,6 +1092,16 @@ bool ofApp::loadCalibration(string dir, bool absolute)
 	// extrinsic calibrations
 	cv::FileStorage fs(calSPath, cv::FileStorage::READ);
 
+	// intrinsics as refined by stereoCalibrate, older files don't have them
+	Mat K[2], D[2];
+	fs["K0"] >> K[0];
+	fs["D0"] >> D[0];
+	fs["K1"] >> K[1];
+	fs["D1"] >> D[1];
+	for (int i = 0; i < 2; i++) {
+		if (!K[i].empty() && !D[i].empty()) calibrations[i].setIntrinsics(K[i], D[i]);
+	}
+
 	// stereo calibration
 	fs["R"] >> R;		// rotation 0->1
 	fs["T"] >> T;		// translation 0->1
@@ -486,10 +1118,14 @@ bool ofApp::loadCalibration(string dir, bool absolute)
 	// create rectification image maps
 
 	const auto& I0 = calibrations[0].getDistortedIntrinsics();
-	const auto& I1 = calibrations[0].getDistortedIntrinsics();
+	const auto& I1 = calibrations[1].getDistortedIntrinsics();
+
+	rectifiers[0].setup(I0.getCameraMatrix(), calibrations[0].getDistCoeffs(), R0, P0, I0.getImageSize(), CAM_ROTATION);
+	rectifiers[1].setup(I1.getCameraMatrix(), calibrations[1].getDistCoeffs(), R1, P1, I1.getImageSize(), CAM_ROTATION);
 
-	cv::initUndistortRectifyMap(I0.getCameraMatrix(), calibrations[0].getDistCoeffs(), R0, P0, I0.getImageSize(), CV_32F, mapX[0], mapY[0]);
-	cv::initUndistortRectifyMap(I1.getCameraMatrix(), calibrations[1].getDistCoeffs(), R1, P1, I1.getImageSize(), CV_32F, mapX[1], mapY[1]);
+	depthMapper.setup(depthSettings, Q);
+	pointCloud.setup(Q, pointCloud.getVoxelSize());
+	faceMatcher.setup(Q, faceMaxDisparity);
 
 	ofLogNotice() << "loaded extrinsics";
 
@@ -498,6 +1134,92 @@ bool ofApp::loadCalibration(string dir, bool absolute)
 	return true;
 }
 
+//--------------------------------------------------------------
+bool ofApp::loadCalibrationBundle(string dir)
+{
+	PROFILE_SCOPE("loadCalibrationBundle");
+
+	// load dir/stereo_calib.bin, (re)building it first if it doesn't match the YAML files in dir
+
+	string calPaths[3] = { ofFilePath::join(dir, "L_calib.yml"), ofFilePath::join(dir, "R_calib.yml"), ofFilePath::join(dir, "stereo_calib.yml") };
+	string path = ofFilePath::join(dir, CalibrationBundle::FILE_NAME);
+	uint64_t hash = CalibrationBundle::hashFiles({ calPaths[0], calPaths[1], calPaths[2] });
+	int rotation = ((CAM_ROTATION % 4) + 4) % 4;
+
+	// rectifiers may still point into the current mapping
+	rectifiers[0].clear();
+	rectifiers[1].clear();
+	bundle.close();
+
+	if (!bundle.load(path) || bundle.getSourceHash() != hash || bundle.getRotation() != rotation) {
+		bundle.close();
+		ofLogNotice() << "calibration bundle missing or out of date, building " << path;
+		if (!CalibrationBundle::build(dir, CAM_ROTATION) || !bundle.load(path)) {
+			bundle.close();
+			return false;
+		}
+	}
+
+	for (const auto& name : { "K0", "D0", "K1", "D1", "size0", "size1", "R", "T", "E", "F", "R0", "R1", "P0", "P1", "Q", "map1_0", "map2_0", "map1_1", "map2_1" }) {
+		if (!bundle.has(name)) {
+			ofLogError() << "calibration bundle " << path << " is missing " << name;
+			bundle.close();
+			return false;
+		}
+	}
+
+	// instrinsic calibrations
+
+	K0 = bundle.get("K0").clone();
+	D0 = bundle.get("D0").clone();
+	K1 = bundle.get("K1").clone();
+	D1 = bundle.get("D1").clone();
+
+	const int* sz0 = bundle.get("size0").ptr<int>();
+	const int* sz1 = bundle.get("size1").ptr<int>();
+	sz = cv::Size(sz0[0], sz0[1]);
+
+	calibrations[0].setup(K0, D0, sz);
+	calibrations[1].setup(K1, D1, cv::Size(sz1[0], sz1[1]));
+
+	// feature data stays in the YAML files until needed, or is parsed now with lazyFeatures: 0
+	calibrations[0].deferFeatures(calPaths[0], true);
+	calibrations[1].deferFeatures(calPaths[1], true);
+	if (!bLazyFeatures) {
+		calibrations[0].loadFeatures();
+		calibrations[1].loadFeatures();
+	}
+
+	bHasIntrinsics = true;
+
+	// extrinsic calibrations
+
+	R = bundle.get("R").clone();
+	T = cv::Vec3d(bundle.get("T").ptr<double>());
+	E = bundle.get("E").clone();
+	F = bundle.get("F").clone();
+	R0 = bundle.get("R0").clone();
+	R1 = bundle.get("R1").clone();
+	P0 = bundle.get("P0").clone();
+	P1 = bundle.get("P1").clone();
+	Q = bundle.get("Q").clone();
+
+	// rectification maps are used straight from the mapping
+
+	rectifiers[0].setup(bundle.get("map1_0"), bundle.get("map2_0"), bundle.getRotation());
+	rectifiers[1].setup(bundle.get("map1_1"), bundle.get("map2_1"), bundle.getRotation());
+
+	depthMapper.setup(depthSettings, Q);
+	pointCloud.setup(Q, pointCloud.getVoxelSize());
+	faceMatcher.setup(Q, faceMaxDisparity);
+
+	bHasExtrinsics = true;
+
+	ofLogNotice() << "loaded calibration bundle " << path;
+
+	return true;
+}
+
 //--------------------------------------------------------------
 bool ofApp::saveIntrinsics(string dir, bool absolute)
 {
@@ -538,6 +1260,13 @@ bool ofApp::saveStereoCalibration(string dir, bool absolute)
 		fs << "P0" << P0;	// projection cam 0
 		fs << "P1" << P1;	// projection cam 1
 		fs << "Q" << Q;		// disparity-to-depth mapping matrix
+		fs << "rms" << stereoRms;				// reprojection error (px)
+		fs << "perViewErrors" << Mat(viewErrors, true);	// per view reprojection error (px)
+		fs << "droppedViews" << Mat(droppedViews, true);	// views left out as outliers
+		fs << "strategy" << calibStrategy.name;		// stereoCalibrate / stereoRectify options used
+		fs << "calibFlags" << calibStrategy.flags;
+		fs << "rectifyFlags" << calibStrategy.rectifyFlags;
+		fs << "alpha" << calibStrategy.alpha;
 		return true;
 	}
 	else {
@@ -547,6 +1276,102 @@ bool ofApp::saveStereoCalibration(string dir, bool absolute)
 }
 
 
+//--------------------------------------------------------------
+void ofApp::benchmarkBoardSearch()
+{
+	// compares coarse-to-fine board search against full res findBoard() on the images in cal_imgs/L + /R
+
+	string dirs[2] = { "cal_imgs/L/", "cal_imgs/R/" };
+
+	int nImgs = 0, nFull = 0, nFast = 0, nMismatch = 0, nCorners = 0;
+	double fullMs = 0, fastMs = 0, errSum = 0, errMax = 0;
+
+	for (int i = 0; i < 2; i++) {
+
+		ofDirectory dir;
+		dir.allowExt("jpg");
+		dir.allowExt("png");
+		dir.allowExt("ppm");
+		dir.allowExt("pgm");
+		dir.listDir(dirs[i]);
+
+		for (std::size_t j = 0; j < dir.size(); j++) {
+
+			ofImage img;
+			if (!img.load(dir[j])) {
+				ofLogError() << "benchmark: error loading " << dir[j].getAbsolutePath();
+				continue;
+			}
+			Mat mat = toCv(img);
+			vector<Point2f> full, fast;
+
+			uint64_t t0 = ofGetElapsedTimeMicros();
+			bool bFull = calibrations[i].findBoard(mat, full);
+			uint64_t t1 = ofGetElapsedTimeMicros();
+			bool bFast = calibrations[i].findBoardCoarseToFine(mat, fast);
+			uint64_t t2 = ofGetElapsedTimeMicros();
+
+			fullMs += (t1 - t0) / 1000.;
+			fastMs += (t2 - t1) / 1000.;
+			nImgs++;
+			nFull += bFull;
+			nFast += bFast;
+
+			if (bFull != bFast || full.size() != fast.size()) {
+				nMismatch++;
+				ofLogWarning() << "benchmark: detection differs on " << dir[j].getFileName() << " - full res: " << bFull << ", coarse-to-fine: " << bFast;
+				continue;
+			}
+			for (std::size_t k = 0; k < full.size(); k++) {
+				double err = cv::norm(full[k] - fast[k]);
+				errSum += err;
+				errMax = max(errMax, err);
+				nCorners++;
+			}
+		}
+	}
+
+	if (nImgs == 0) {
+		ofLogError() << "benchmark: no images found in ./data/cal_imgs/L or /R";
+		return;
+	}
+
+	ofLogNotice() << "board search benchmark - " << nImgs << " images, search size " << calibrations[0].getSearchSize() << "px";
+	ofLogNotice() << "  full res:       found " << nFull << ", " << fullMs / nImgs << " ms/img";
+	ofLogNotice() << "  coarse-to-fine: found " << nFast << ", " << fastMs / nImgs << " ms/img";
+	ofLogNotice() << "  detection mismatches: " << nMismatch;
+	ofLogNotice() << "  corner deviation from full res (px) - mean: " << (nCorners ? errSum / nCorners : 0.) << ", max: " << errMax;
+}
+
+//--------------------------------------------------------------
+void ofApp::saveProfile()
+{
+	// histograms for spreadsheets, recent events for chrome://tracing / Perfetto
+#if PROFILING
+	string path = ofToDataPath("profiles/profile_" + ofGetTimestampString(), true);
+	if (Profiler::get().saveCsv(path + ".csv") && Profiler::get().saveTrace(path + ".json")) {
+		ofLogNotice() << "saved stage timings to " << path << ".csv + .json";
+	}
+#else
+	ofLogNotice() << "stage timing is compiled out (PROFILING=0)";
+#endif
+}
+
+//--------------------------------------------------------------
+void ofApp::toggleRecording()
+{
+	if (recorder.isRecording()) {
+		recorder.stop();
+		return;
+	}
+	if (!capture.getFrameRef(0) || !capture.getFrameRef(1)) {
+		ofLogError() << "no stereo pair captured yet, nothing to record";
+		return;
+	}
+	string path = ofToDataPath("recordings/rec_" + ofGetTimestampString("%Y-%m-%d-%H-%M-%S") + ".strec", true);
+	recorder.start(path, capture.getFrame(0), capture.getFrame(1), CAM_ROTATION);
+}
+
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key) {
 
@@ -555,6 +1380,12 @@ void ofApp::keyPressed(int key) {
 //--------------------------------------------------------------
 void ofApp::keyReleased(int key) {
 
+	// captures are still coming in from disk
+	if (pairLoader.isLoading() && (key == OF_KEY_RETURN || key == OF_KEY_DEL || key == 'i' || key == 'I' || key == 'c' || key == 'C' || key == 't' || key == 'T')) {
+		ofLogNotice() << "still loading calibration images (" << pairLoader.getNumDone() << " / " << pairLoader.getNumTotal() << ")";
+		return;
+	}
+
 	// SEARCHING
 	if (key == ' ') {
 		bSearching = !bSearching;
@@ -568,11 +1399,17 @@ void ofApp::keyReleased(int key) {
 
 	// CLEAR
 	else if (key == OF_KEY_DEL) {
-		foundImgs.clear();
+		captures.clear();
+		coverage.clear();
+		nRedundant = 0;
+		nextSaveIndex = 0;
+		liveCalibrator.reset();
+		liveEstimate = LiveCalibrator::Estimate();
 		bHasExtrinsics = false;
 		bHasIntrinsics = false;
 		bUndistort = false;
 		bFaceDepth = false;
+		bDepthMap = false;
 		bRectify = false;
 	}
 
@@ -591,6 +1428,7 @@ void ofApp::keyReleased(int key) {
 		if (bUndistort) {
 			bUndistort = false; // turn off
 			bFaceDepth = false;
+			bDepthMap = false;
 			bRectify = false;
 		}
 		else if (bHasIntrinsics){
@@ -605,6 +1443,7 @@ void ofApp::keyReleased(int key) {
 		if (bRectify) {
 			bRectify = false; // turn off
 			bFaceDepth = false;
+			bDepthMap = false;
 			// leave undistort on
 		}
 		else if (bHasExtrinsics) {
@@ -627,51 +1466,108 @@ void ofApp::keyReleased(int key) {
 	else if (key == 'f' || key == 'F') {
 		if (bFaceDepth) {
 			bFaceDepth = false;
+			bDepthMap = false;
 			bUndistort = false;
 			bRectify = false;
 		}
 		else if (bHasIntrinsics && bHasExtrinsics) {
+			faceMatcher.clear();
 			bFaceDepth = true;
 			bRectify = true; // rectification needed for face depth calculation
 			bUndistort = true;
 		}
 	}
+	else if (key == 's' || key == 'S') {
+		bEvaluateStrategies = !bEvaluateStrategies;
+	}
+	else if (key == 'v' || key == 'V') {
+		bCoverageFilter = !bCoverageFilter;
+	}
+	else if (key == 't' || key == 'T') {
+		trimCaptures();
+		if (bLiveCalibration) postLiveCalibration();
+	}
+	else if (key == 'a' || key == 'A') {
+		bLiveCalibration = !bLiveCalibration;
+		if (bLiveCalibration) postLiveCalibration();	// catch up on pairs saved or loaded so far
+	}
+	else if (key == 'd' || key == 'D') {
+		if (bDepthMap) {
+			bDepthMap = false;
+		}
+		else if (bHasExtrinsics && depthMapper.isSetup()) {
+			bDepthMap = true;
+			bRectify = true; // matching runs on the rectified frames
+			bUndistort = true;
+		}
+	}
+	else if (key == 'x' || key == 'X') {
+		// current frame's point cloud
+		if (bDepthMap && depthMapper.isSetup()) {
+			pointCloud.compute(depthMapper.getDisparity(), depthMapper.getRoi(), depthSettings.minDisparity,
+				bCloudColor ? &undImgs[0].getPixels() : nullptr, capture.getTimestamp(0));
+			pointCloud.savePly("clouds/cloud_" + ofGetTimestampString() + ".ply");
+		}
+	}
+	else if (key == 'k' || key == 'K') {
+		if (cloudStream.isOpen()) {
+			cloudStream.close();
+		}
+		else if (bDepthMap) {
+			cloudStream.open("clouds/stream_" + ofGetTimestampString() + ".pcs");
+		}
+	}
+	else if (key == 'p' || key == 'P') {
+		bColorPreview = !bColorPreview;
+	}
+	else if (key == 'o' || key == 'O') {
+		bProfilerOverlay = !bProfilerOverlay;
+	}
+	else if (key == 'w' || key == 'W') {
+		saveProfile();
+	}
+	else if (key == 'b' || key == 'B') {
+		benchmarkBoardSearch();
+	}
+	else if (key == 'm' || key == 'M') {
+		toggleRecording();
+	}
+	else if (cameraMode == CAMERA_REPLAY && replay.isOpen() && (key == OF_KEY_LEFT || key == OF_KEY_RIGHT || key == OF_KEY_HOME || key == OF_KEY_END)) {
+		if (key == OF_KEY_HOME) {
+			replay.seek(0);
+		}
+		else if (key == OF_KEY_END) {
+			replay.setRealtime(!replay.getRealtime());
+		}
+		else {
+			// +-5 sec of recorded time
+			uint64_t t = replay.getRecordedTimestamp(min(replay.getPosition(), replay.getNumFrames() - 1));
+			replay.seekTime(key == OF_KEY_RIGHT ? t + 5000000 : (t > 5000000 ? t - 5000000 : 0));
+		}
+	}
 	else if (key == 'c' || key == 'C') {
 		// load checkerboard images from default folder paths : bin/data/cal_imgs/L/ + /R/
 
 		if (ofDirectory::doesDirectoryExist("cal_imgs/L/") && ofDirectory::doesDirectoryExist("cal_imgs/R/")) {
 
-			foundImgs.clear();
+			captures.clear();
+			coverage.clear();
+			nRedundant = 0;
+			liveCalibrator.reset();
+			liveEstimate = LiveCalibrator::Estimate();
 			bHasIntrinsics = false;
 			bHasExtrinsics = false;
 			bUndistort = false;
 			bRectify = false;
 			bFaceDepth = false;
+			bDepthMap = false;
 
-			ofDirectory dirL;
-			dirL.allowExt("jpg");
-			dirL.allowExt("png");
-			dirL.listDir("cal_imgs/L/");
-
-			ofDirectory dirR;
-			dirR.allowExt("jpg");
-			dirR.allowExt("png");
-			dirR.listDir("cal_imgs/R/");
-
-			ofLogNotice() << "found " << dirL.size() << " left, " << dirR.size() << " right images in ./data/cal_imgs/L and /R";
-
-			int maxPairs = min(dirL.size(), dirR.size());
-
-			ofImage L, R;
-
-			for (std::size_t i = 0; i < maxPairs; i++) {
-
-				if (L.loadImage(dirL[i]) && R.loadImage(dirR[i])) {
-					foundImgs.emplace_back(L, R);
-				}
-				else {
-					ofLogError() << "error loading image pair: " << dirL[i].getAbsolutePath() << ", " << dirR[i].getAbsolutePath();
-				}
+			// decoded + searched on a worker pool, pairs show up in update() as they finish
+			if (pairLoader.start("cal_imgs/L/", "cal_imgs/R/", calibrations[0], calibrations[1], captures)) {
+				nextSaveIndex = pairLoader.getMaxIndex() + 1;
+			}
+			else {
+				nextSaveIndex = 0;
 			}
 		}
 		else {
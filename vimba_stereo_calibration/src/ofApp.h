@@ -1,9 +1,28 @@
 #pragma once
 
 #include "ofMain.h"
-#include "ofxVimba.h"
 #include "ofxOpenCv.h"
 #include "ofxCv.h"
+#include "BoardFinder.h"
+#include "CameraCalibration.h"
+#include "Rectifier.h"
+#include "CalibrationBundle.h"
+#include "StereoCapture.h"
+#include "VimbaSource.h"
+#include "SyntheticStereo.h"
+#include "StereoRecorder.h"
+#include "StereoReplay.h"
+#include "ImageWriter.h"
+#include "CaptureStore.h"
+#include "PairLoader.h"
+#include "LiveCalibrator.h"
+#include "CoverageIndex.h"
+#include "StereoSolver.h"
+#include "DepthMapper.h"
+#include "PointCloud.h"
+#include "PointCloudStream.h"
+#include "FaceMatcher.h"
+#include "Profiler.h"
 
 class ofApp : public ofBaseApp{
 
@@ -13,15 +32,23 @@ class ofApp : public ofBaseApp{
 		void draw();
 		void exit();
 
+		void findCorners();
 		bool calibrateIntrinsics();
 		bool stereoCalibrate();
 
 		bool fullCalibration();
 		
 		bool loadCalibration(string dir, bool absolute = true);
+		bool loadCalibrationBundle(string dir);
 
 		bool saveIntrinsics(string dir, bool absolute = true);
 		bool saveStereoCalibration(string dir, bool absolute = true);
+
+		void benchmarkBoardSearch();
+		void postLiveCalibration();
+		void trimCaptures();
+		void saveProfile();
+		void toggleRecording();
 	
 
 		void keyPressed(int key);
@@ -38,18 +65,63 @@ class ofApp : public ofBaseApp{
 
 		string camIds[2];
 		
-		ofxVimba::ofxVimbaCam cams[2];
+		// camera source, config camera: "vimba" / "synthetic" / "replay"
+		enum CameraMode { CAMERA_VIMBA, CAMERA_SYNTHETIC, CAMERA_REPLAY };
+		CameraMode cameraMode = CAMERA_VIMBA;
+		VimbaSource vimbaCams[2];
+		SyntheticStereo synthetic;	// rendered rig with known calibration
+		SyntheticStereo::Settings syntheticSettings;
+		StereoReplay replay;		// recording played back from disk
+		string replayFile;
+		bool bReplayRealtime = true, bReplayLoop = true;
+		CameraSource* sources[2] = { nullptr, nullptr };
+		StereoCapture capture;	// capture threads + stereo pairing
+		StereoRecorder recorder;	// raw pairs to /data/recordings/, declared after capture as it holds its frames
+		float maxSkewMs;
+
+		// capture pixel format
+		enum PixelMode { PIXELS_RGB, PIXELS_MONO, PIXELS_BAYER };
+		string pixelFormat = "RGB8";	// GenICam name, set on the cameras
+		PixelMode pixelMode = PIXELS_RGB;
+		int bayerToGray = 0, bayerToRgb = 0;	// cv::cvtColor codes for the camera's bayer pattern
+
+		const ofPixels& workingFrame(int i, const ofPixels& raw);
+		ofPixels lumaFrames[2];		// single channel working frames when the camera sends bayer (or colour in mono mode)
+
+		// colour reconstructed for display only
+		void updateColorPreview(int i, const ofPixels& raw);
+		bool bColorPreview = false;
+		ofPixels colorFrames[2], colorRotated[2];
+		ofImage previewImgs[2];
 		ofImage imgs[2];
 		ofImage undImgs[2];
 
-		ofxCv::Calibration calibrations[2];	// instrinsic calibrations
+		CameraCalibration calibrations[2];	// instrinsic calibrations
+
+		BoardFinder boardFinder;	// async board search
+		ImageWriter imageWriter;	// saves found pairs off the main thread, holds boardFinder's buffers until written
 
 		float foundTime, waitTime;
 		bool bSearching, bFound, bUndistort, bRectify;
 		bool bHasIntrinsics, bHasExtrinsics;
 		bool bCalibrating = false;
 
-		vector<pair<ofImage,ofImage>> foundImgs;
+		CaptureStore captures;		// found / loaded pairs: corners, poses + thumbnails in memory, images on disk
+		ofImage lastThumbs[2];		// thumbnails of the last saved pair
+		PairLoader pairLoader;		// 'C' - loads cal_imgs/L + /R in the background
+		int nextSaveIndex = 0;		// file number for the next saved pair, past anything loaded from disk
+
+		// board pose coverage of the captures
+		CoverageIndex coverage;
+		bool bCoverageFilter = true;	// search only keeps pairs that cover a new pose
+		bool bTrimBeforeCalibration = false;	// reduce captures to a minimal covering set before calibrating
+		int nRedundant = 0;				// pairs found but rejected as already covered
+
+		// incremental calibration, re-solved in the background on every accepted pair
+		LiveCalibrator liveCalibrator;
+		LiveCalibrator::Estimate liveEstimate;
+		double liveChange = 0;		// largest relative change of fx (L, R) / baseline since the previous estimate
+		bool bLiveCalibration = false;
 
 		// intrinsics calibration matrices
 
@@ -63,13 +135,48 @@ class ofApp : public ofBaseApp{
 
 		cv::Mat R0, R1, P0, P1, Q;	// rectification matrices: rotation0, rotation1, projection0, projection1, disparity-to-depth
 
-		cv::Mat mapX[2];
-		cv::Mat mapY[2];	// rectification image maps
+		StereoSolver stereoSolver;	// stereo calibration with per-view errors + outlier rejection
+		double stereoRms = 0;		// reprojection error of the last stereo calibration (px)
+		vector<double> viewErrors;	// per view reprojection errors of the last stereo calibration (px)
+		vector<int> droppedViews;	// views rejected as outliers
+
+		vector<StereoSolver::Strategy> calibStrategies;	// candidates, see config.yml
+		StereoSolver::Strategy calibStrategy;			// used for the next stereo calibration, the winner after an evaluation
+		bool bEvaluateStrategies = false;				// try all candidates on every stereo calibration
+
+		Rectifier rectifiers[2];	// rectification image maps, raw frame -> rectified
 
+		// only rectify what's used (face windows / work region), the whole frame every previewInterval frames
+		bool bRoiRectification = true;
+		int previewInterval = 10, previewCount = 0;
+		cv::Rect workRoi;				// rectified region always needed, empty = none
+		float rectifiedFraction = 1;	// of both full frames, last frame
+		CalibrationBundle bundle;	// mmap'ed calibration, rectifiers may use its maps directly
+		bool bLazyFeatures = false;	// load calibration files without per-view feature data, see CameraCalibration::loadLazy()
+
+
+		// dense disparity + depth on the rectified frames
+		DepthMapper depthMapper;
+		DepthMapper::Settings depthSettings;
+		bool bDepthMap = false;
+		ofImage disparityImg;
+
+		// 3D points from the disparity map
+		PointCloud pointCloud;
+		PointCloudStream cloudStream;	// 'K' - records every frame's cloud to data/clouds/
+		bool bCloudColor = true;
 
 		// face finder for rough depth calc
 		ofxCv::ObjectFinder finders[2];
 		bool bFaceDepth, bHasFace;
 		ofRectangle faces[2];
 		float faceDepth;
+
+		// left view detection + epipolar matching in the right view, tracked between frames
+		FaceMatcher faceMatcher;
+		bool bEpipolarFaces = true;	// false = independent detectors in both views
+		int faceMaxDisparity = 256;
+
+		// stage timing (Profiler.h), per-stage latencies drawn over the left view
+		bool bProfilerOverlay = false;
 };
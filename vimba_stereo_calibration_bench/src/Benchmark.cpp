@@ -0,0 +1,134 @@
+#include "Benchmark.h"
+#include <numeric>
+
+//--------------------------------------------------------------
+void Benchmark::add(const string& stage, double ms)
+{
+	for (auto& s : stages) {
+		if (s.first == stage) {
+			s.second.push_back(ms);
+			return;
+		}
+	}
+	stages.emplace_back(stage, vector<double>(1, ms));
+}
+
+//--------------------------------------------------------------
+Benchmark::Stats Benchmark::getStats(const string& stage) const
+{
+	Stats stats;
+	stats.name = stage;
+
+	for (auto& s : stages) {
+		if (s.first != stage || s.second.empty()) continue;
+
+		vector<double> samples = s.second;
+		std::sort(samples.begin(), samples.end());
+		size_t n = samples.size();
+
+		// nearest rank
+		auto percentile = [&](double p) {
+			size_t rank = (size_t)std::ceil(p / 100. * n);
+			return samples[std::min(n, std::max<size_t>(rank, 1)) - 1];
+		};
+
+		stats.n = n;
+		stats.min = samples.front();
+		stats.max = samples.back();
+		stats.mean = std::accumulate(samples.begin(), samples.end(), 0.) / n;
+		stats.p50 = percentile(50);
+		stats.p90 = percentile(90);
+		stats.p99 = percentile(99);
+		break;
+	}
+
+	return stats;
+}
+
+//--------------------------------------------------------------
+vector<Benchmark::Stats> Benchmark::getStats() const
+{
+	vector<Stats> all;
+	for (auto& s : stages) {
+		all.push_back(getStats(s.first));
+	}
+	return all;
+}
+
+//--------------------------------------------------------------
+void Benchmark::setInfo(const string& key, const string& value)
+{
+	info.emplace_back(key, quote(value));
+}
+
+//--------------------------------------------------------------
+void Benchmark::setInfo(const string& key, double value)
+{
+	info.emplace_back(key, ofToString(value));
+}
+
+//--------------------------------------------------------------
+string Benchmark::toJson() const
+{
+	std::ostringstream out;
+	out << std::setprecision(6);
+
+	out << "{\n";
+	for (auto& i : info) {
+		out << "  " << quote(i.first) << ": " << i.second << ",\n";
+	}
+	out << "  \"unit\": \"ms\",\n";
+	out << "  \"stages\": [";
+
+	auto all = getStats();
+	for (size_t i = 0; i < all.size(); i++) {
+		auto& s = all[i];
+		out << (i ? ",\n" : "\n")
+			<< "    { \"name\": " << quote(s.name) << ", \"n\": " << s.n
+			<< ", \"min\": " << s.min << ", \"mean\": " << s.mean
+			<< ", \"p50\": " << s.p50 << ", \"p90\": " << s.p90 << ", \"p99\": " << s.p99
+			<< ", \"max\": " << s.max << " }";
+	}
+	out << "\n  ]\n}\n";
+
+	return out.str();
+}
+
+//--------------------------------------------------------------
+bool Benchmark::saveJson(const string& path) const
+{
+	ofstream file(path, std::ios::binary);
+	if (!file) {
+		ofLogError("Benchmark") << "can't write " << path;
+		return false;
+	}
+	file << toJson();
+	return (bool)file;
+}
+
+//--------------------------------------------------------------
+void Benchmark::log() const
+{
+	for (auto& s : getStats()) {
+		ofLogNotice("Benchmark") << s.name << " - n " << s.n << ", p50 " << s.p50 << " ms, p90 " << s.p90
+			<< " ms, p99 " << s.p99 << " ms, max " << s.max << " ms";
+	}
+}
+
+//--------------------------------------------------------------
+string Benchmark::quote(const string& s)
+{
+	string q = "\"";
+	for (char c : s) {
+		switch (c) {
+			case '"': q += "\\\""; break;
+			case '\\': q += "\\\\"; break;
+			case '\n': q += "\\n"; break;
+			case '\t': q += "\\t"; break;
+			default:
+				if ((unsigned char)c < 0x20) q += ofVAArgsToString("\\u%04x", c);
+				else q += c;
+		}
+	}
+	return q + "\"";
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ofMain.h"
+
+// wall clock samples per named stage, reported as JSON
+//	- stages are reported in the order they were first timed
+//	- percentiles are nearest-rank over all samples of a stage
+
+class Benchmark {
+
+	public:
+
+		struct Stats {
+			string name;
+			size_t n = 0;
+			double min = 0, mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;	// ms
+		};
+
+		// run fn() iterations times after warmup untimed runs, one sample per run
+		template<typename Fn>
+		void time(const string& stage, int iterations, Fn fn, int warmup = 1) {
+			for (int i = 0; i < warmup; i++) {
+				fn();
+			}
+			for (int i = 0; i < iterations; i++) {
+				auto t0 = std::chrono::steady_clock::now();
+				fn();
+				add(stage, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+			}
+		}
+
+		// a sample measured elsewhere
+		void add(const string& stage, double ms);
+
+		Stats getStats(const string& stage) const;
+		vector<Stats> getStats() const;
+
+		// extra top level fields, e.g. thread count or a commit label
+		void setInfo(const string& key, const string& value);
+		void setInfo(const string& key, double value);
+
+		string toJson() const;
+		bool saveJson(const string& path) const;
+
+		// one line per stage
+		void log() const;
+
+	protected:
+
+		static string quote(const string& s);
+
+		vector<pair<string, vector<double>>> stages;
+		vector<pair<string, string>> info;	// key, JSON value
+};
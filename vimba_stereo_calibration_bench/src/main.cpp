@@ -0,0 +1,369 @@
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "Benchmark.h"
+#include "CameraCalibration.h"
+#include "CalibrationBundle.h"
+#include "Rectifier.h"
+#include "StereoSolver.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+// times the calibration + rectification hot paths of vimba_stereo_calibration without cameras
+//	- reads config.yml and cal_imgs/ from the app's bin/data
+//	- without saved images in cal_imgs/L + /R, board images are rendered onto the corners stored in L_calib.yml / R_calib.yml
+//	- writes ms per call for every stage as JSON, with percentiles, to compare commits and thread counts
+//
+// usage: vimba_stereo_calibration_bench [--threads n] [--frames n] [--solves n] [--loads n] [--data dir] [--out file] [--label text]
+
+const int CAM_ROTATION = -1; // as in ofApp.cpp - clockwise quarter turns from raw sensor frames to calibrated images
+
+struct Options {
+	int threads = -1;			// cv::setNumThreads(), -1 = OpenCV default
+	int frames = 200;			// iterations of the per-frame stages
+	int solves = 5;				// iterations of the calibration solves
+	int loads = 20;				// iterations of loadCalibration()
+	string dataDir;				// default: the app's bin/data
+	string out = "benchmark.json";
+	string label;				// e.g. a commit hash, copied to the JSON
+};
+
+//--------------------------------------------------------------
+bool parseArgs(int argc, char* argv[], Options& opt)
+{
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (i + 1 >= argc) {
+			ofLogError() << "missing value for " << arg;
+			return false;
+		}
+		string value = argv[++i];
+		if (arg == "--threads") opt.threads = ofToInt(value);
+		else if (arg == "--frames") opt.frames = max(1, ofToInt(value));
+		else if (arg == "--solves") opt.solves = max(1, ofToInt(value));
+		else if (arg == "--loads") opt.loads = max(1, ofToInt(value));
+		else if (arg == "--data") opt.dataDir = value;
+		else if (arg == "--out") opt.out = value;
+		else if (arg == "--label") opt.label = value;
+		else {
+			ofLogError() << "unknown argument " << arg;
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+bool renderBoard(const vector<Point2f>& corners, cv::Size patternSize, cv::Size imageSize, Mat& dst)
+{
+	// chessboard of (w + 1) x (h + 1) squares warped so its inner corners land on corners
+
+	const int s = 40;
+	Mat board((patternSize.height + 3) * s, (patternSize.width + 3) * s, CV_8UC1, Scalar(255));
+	vector<Point2f> src;
+	for (int y = 0; y <= patternSize.height; y++) {
+		for (int x = 0; x <= patternSize.width; x++) {
+			if ((x + y) % 2 == 0) {
+				rectangle(board, cv::Rect((x + 1) * s, (y + 1) * s, s, s), Scalar(0), FILLED);
+			}
+		}
+	}
+	for (int y = 0; y < patternSize.height; y++) {
+		for (int x = 0; x < patternSize.width; x++) {
+			src.emplace_back((x + 2) * s, (y + 2) * s);	// same order as createObjectPoints()
+		}
+	}
+
+	Mat H = findHomography(src, corners);
+	if (H.empty()) return false;
+	warpPerspective(board, dst, H, imageSize, INTER_LINEAR, BORDER_CONSTANT, Scalar(128));
+	GaussianBlur(dst, dst, cv::Size(3, 3), 0);	// soften the edges a bit, like a lens would
+	return true;
+}
+
+//--------------------------------------------------------------
+int main(int argc, char* argv[]) {
+
+	Options opt;
+	if (!parseArgs(argc, argv, opt)) {
+		cout << "usage: vimba_stereo_calibration_bench [--threads n] [--frames n] [--solves n] [--loads n] [--data dir] [--out file] [--label text]" << endl;
+		return EXIT_FAILURE;
+	}
+
+	if (opt.dataDir.empty()) {
+		opt.dataDir = ofFilePath::join(ofFilePath::getCurrentExeDir(), "../../vimba_stereo_calibration/bin/data/");
+	}
+	ofSetDataPathRoot(ofFilePath::addTrailingSlash(opt.dataDir));
+
+	if (opt.threads >= 0) {
+		cv::setNumThreads(opt.threads);
+	}
+
+	// ------------------------- //
+	// same setup as the app's   //
+	// ------------------------- //
+
+	FileStorage settings(ofToDataPath("config.yml"), FileStorage::READ);
+	if (!settings.isOpened()) {
+		ofLogError() << "no config file found at: " << ofToDataPath("config.yml", true);
+		return EXIT_FAILURE;
+	}
+
+	CameraCalibration calibrations[2];
+	for (auto& calibration : calibrations) {
+		calibration.setPatternSize(settings["xCount"], settings["yCount"]);
+		calibration.setSquareSize(settings["squareSize"]);
+		CalibrationPattern patternType = CHESSBOARD;
+		switch ((int)settings["patternType"]) {
+			case 1: patternType = CIRCLES_GRID; break;
+			case 2: patternType = ASYMMETRIC_CIRCLES_GRID; break;
+		}
+		calibration.setPatternType(patternType);
+		calibration.setSearchSize(settings["searchSize"]);
+	}
+	bool bLazyFeatures = (int)settings["lazyFeatures"];
+	bool bMono = !settings["pixelFormat"].empty() && (string)settings["pixelFormat"] != "RGB8";	// Mono8 / Bayer run on one channel
+
+	StereoSolver stereoSolver;
+	StereoSolver::Settings solverSettings;
+	solverSettings.maxViewError = settings["maxViewError"].empty() ? 0. : (double)settings["maxViewError"];
+	stereoSolver.setup(solverSettings);
+
+	string dir = ofToDataPath("cal_imgs", true);
+	string calPaths[3] = { ofFilePath::join(dir, "L_calib.yml"), ofFilePath::join(dir, "R_calib.yml"), ofFilePath::join(dir, "stereo_calib.yml") };
+	for (auto& path : calPaths) {
+		if (!ofFile::doesFileExist(path, false)) {
+			ofLogError() << "can't benchmark without " << path;
+			return EXIT_FAILURE;
+		}
+	}
+
+	Benchmark bench;
+	bench.setInfo("label", opt.label);
+	bench.setInfo("opencv", CV_VERSION);
+	bench.setInfo("threads", cv::getNumThreads());
+	bench.setInfo("cpus", std::thread::hardware_concurrency());
+
+	// ----------------- //
+	// loadCalibration() //
+	// ----------------- //
+
+	// YAML path, as ofApp::loadCalibration() without a bundle
+	bench.time(bLazyFeatures ? "loadCalibration yaml (lazy features)" : "loadCalibration yaml", opt.loads, [&]() {
+		CameraCalibration cal[2] = { calibrations[0], calibrations[1] };
+		Rectifier rectifiers[2];
+		for (int i = 0; i < 2; i++) {
+			if (bLazyFeatures) cal[i].loadLazy(calPaths[i], true);
+			else cal[i].load(calPaths[i], true);
+		}
+		cv::Mat R, T, E, F, R0, R1, P0, P1, Q;
+		FileStorage fs(calPaths[2], FileStorage::READ);
+		fs["R"] >> R; fs["T"] >> T; fs["E"] >> E; fs["F"] >> F;
+		fs["R0"] >> R0; fs["R1"] >> R1; fs["P0"] >> P0; fs["P1"] >> P1; fs["Q"] >> Q;
+		const auto& I0 = cal[0].getDistortedIntrinsics();
+		const auto& I1 = cal[1].getDistortedIntrinsics();
+		rectifiers[0].setup(I0.getCameraMatrix(), cal[0].getDistCoeffs(), R0, P0, I0.getImageSize(), CAM_ROTATION);
+		rectifiers[1].setup(I1.getCameraMatrix(), cal[1].getDistCoeffs(), R1, P1, I1.getImageSize(), CAM_ROTATION);
+	});
+
+	// bundle path, as ofApp::loadCalibrationBundle() - (re)built outside the timing if it's stale
+	string bundlePath = ofFilePath::join(dir, CalibrationBundle::FILE_NAME);
+	{
+		CalibrationBundle bundle;
+		uint64_t hash = CalibrationBundle::hashFiles({ calPaths[0], calPaths[1], calPaths[2] });
+		if (!bundle.load(bundlePath) || bundle.getSourceHash() != hash || bundle.getRotation() != ((CAM_ROTATION % 4) + 4) % 4) {
+			bundle.close();
+			if (!CalibrationBundle::build(dir, CAM_ROTATION) || !bundle.load(bundlePath)) {
+				ofLogError() << "can't benchmark without " << bundlePath;	// a failed load would time nothing
+				return EXIT_FAILURE;
+			}
+		}
+	}
+	bench.time("loadCalibration bundle", opt.loads, [&]() {
+		CalibrationBundle bundle;
+		CameraCalibration cal[2] = { calibrations[0], calibrations[1] };
+		Rectifier rectifiers[2];
+		bundle.load(bundlePath);	// checked above
+		CalibrationBundle::hashFiles({ calPaths[0], calPaths[1], calPaths[2] });	// staleness check
+		const int* sz0 = bundle.get("size0").ptr<int>();
+		const int* sz1 = bundle.get("size1").ptr<int>();
+		cal[0].setup(bundle.get("K0").clone(), bundle.get("D0").clone(), cv::Size(sz0[0], sz0[1]));
+		cal[1].setup(bundle.get("K1").clone(), bundle.get("D1").clone(), cv::Size(sz1[0], sz1[1]));
+		cal[0].deferFeatures(calPaths[0], true);
+		cal[1].deferFeatures(calPaths[1], true);
+		for (const auto& name : { "R", "T", "E", "F", "R0", "R1", "P0", "P1", "Q" }) {
+			bundle.get(name).clone();
+		}
+		rectifiers[0].setup(bundle.get("map1_0"), bundle.get("map2_0"), bundle.getRotation());
+		rectifiers[1].setup(bundle.get("map1_1"), bundle.get("map2_1"), bundle.getRotation());
+	});
+
+	// reference data for the other stages: saved corners, intrinsics and rectification
+	for (int i = 0; i < 2; i++) {
+		calibrations[i].load(calPaths[i], true);
+	}
+	if (calibrations[0].size() == 0 || calibrations[0].size() != calibrations[1].size()) {
+		ofLogError() << "calibration files need the same number of views with feature data";
+		return EXIT_FAILURE;
+	}
+	cv::Size sz = calibrations[0].getDistortedIntrinsics().getImageSize();
+	cv::Mat K[2], D[2];
+	for (int i = 0; i < 2; i++) {
+		K[i] = calibrations[i].getDistortedIntrinsics().getCameraMatrix().clone();
+		D[i] = calibrations[i].getDistCoeffs().clone();
+	}
+	vector<vector<Point2f>> imagePoints[2] = { calibrations[0].imagePoints, calibrations[1].imagePoints };
+	size_t nViews = imagePoints[0].size();
+
+	// -------------- //
+	// board images   //
+	// -------------- //
+
+	vector<Mat> images[2];
+	string imgDirs[2] = { "cal_imgs/L/", "cal_imgs/R/" };
+	for (int i = 0; i < 2; i++) {
+		ofDirectory imgDir;
+		imgDir.allowExt("jpg");
+		imgDir.allowExt("png");
+		imgDir.allowExt("ppm");
+		imgDir.allowExt("pgm");
+		imgDir.listDir(imgDirs[i]);
+		imgDir.sort();
+		for (size_t j = 0; j < imgDir.size(); j++) {
+			ofPixels pix;
+			if (ofLoadImage(pix, imgDir.getPath(j))) {
+				images[i].push_back(toCv(pix).clone());
+			}
+		}
+	}
+	bool bSynthetic = images[0].empty() || images[1].empty();
+	if (bSynthetic) {
+		if (calibrations[0].getPatternType() != CHESSBOARD) {
+			ofLogError() << "no images in cal_imgs/L + /R, and only chessboards can be rendered";
+			return EXIT_FAILURE;
+		}
+		for (int i = 0; i < 2; i++) {
+			images[i].clear();
+			for (auto& corners : imagePoints[i]) {
+				Mat img;
+				if (renderBoard(corners, calibrations[i].getPatternSize(), sz, img)) {
+					images[i].push_back(img);
+				}
+			}
+		}
+		ofLogNotice() << "no images in cal_imgs/L + /R, rendered " << images[0].size() << " boards from the saved corners";
+	}
+	bench.setInfo("images", images[0].size() + images[1].size());
+	bench.setInfo("views", nViews);
+	bench.setInfo("synthetic", bSynthetic ? 1 : 0);	// 1 = boards rendered from the saved corners
+
+	// ---------- //
+	// findBoard  //
+	// ---------- //
+
+	for (int i = 0; i < 2; i++) {
+		for (auto& img : images[i]) {
+			vector<Point2f> corners;
+			bench.time("findBoard", 1, [&]() { calibrations[i].findBoard(img, corners); }, 0);
+			bench.time("findBoardCoarseToFine", 1, [&]() { calibrations[i].findBoardCoarseToFine(img, corners); }, 0);
+		}
+	}
+
+	// -------------------------------- //
+	// Calibration::add / calibrate()   //
+	// -------------------------------- //
+
+	for (int n = 0; n < opt.solves; n++) {
+		for (int i = 0; i < 2; i++) {
+			calibrations[i].resetCalibration();
+			for (auto& corners : imagePoints[i]) {
+				bench.time("Calibration::add", 1, [&]() { calibrations[i].add(corners, sz); }, 0);
+			}
+			bench.time("Calibration::calibrate", 1, [&]() { calibrations[i].calibrate(); }, 0);
+		}
+	}
+
+	// ---------------------------------------------------- //
+	// stereoCalibrate() - StereoSolver + cv::stereoRectify //
+	// ---------------------------------------------------- //
+
+	vector<vector<Point3f>> objectPoints(nViews, Calibration::createObjectPoints(calibrations[0].getPatternSize(), calibrations[0].getSquareSize(), calibrations[0].getPatternType()));
+	StereoSolver::Result result;
+	bench.time("stereoCalibrate", opt.solves, [&]() {
+		stereoSolver.solve(objectPoints, imagePoints[0], imagePoints[1], K[0], D[0], K[1], D[1], sz, result);
+	});
+	if (result.R.empty()) {
+		ofLogError() << "stereo calibration failed";
+		return EXIT_FAILURE;
+	}
+
+	cv::Mat R0, R1, P0, P1, Q;
+	bench.time("stereoRectify", opt.solves, [&]() {
+		cv::stereoRectify(result.K[0], result.D[0], result.K[1], result.D[1], sz, result.R, result.T, R0, R1, P0, P1, Q, 0, -1);
+	});
+
+	// ------------------------ //
+	// initUndistortRectifyMap  //
+	// ------------------------ //
+
+	cv::Mat map1, map2;
+	bench.time("initUndistortRectifyMap", opt.solves, [&]() {
+		cv::initUndistortRectifyMap(result.K[0], result.D[0], R0, P0, sz, CV_16SC2, map1, map2);
+	});
+	Rectifier rectifier;
+	bench.time("Rectifier::setup (rotation folded in)", opt.solves, [&]() {
+		rectifier.setup(result.K[0], result.D[0], R0, P0, sz, CAM_ROTATION);
+	});
+
+	// ---------------------------- //
+	// per frame: rotate + rectify  //
+	// ---------------------------- //
+
+	// raw sensor frames, i.e. the left board images turned back
+	vector<ofPixels> raws(images[0].size());
+	for (size_t j = 0; j < images[0].size(); j++) {
+		Mat src = images[0][j], conv;
+		if (!bMono && src.channels() == 1) cvtColor(src, conv, COLOR_GRAY2RGB);
+		else if (bMono && src.channels() == 3) cvtColor(src, conv, COLOR_RGB2GRAY);
+		else conv = src;
+		ofPixels rotated;
+		toOf(conv, rotated);
+		rotated.rotate90To(raws[j], -CAM_ROTATION);
+	}
+
+	ofPixels rotated, rectified;
+	size_t frame = 0;
+	bench.time("rotate90 + remap", opt.frames, [&]() {
+		const ofPixels& raw = raws[frame++ % raws.size()];
+		raw.rotate90To(rotated, CAM_ROTATION);
+		rectified.allocate(rotated.getWidth(), rotated.getHeight(), rotated.getNumChannels());
+		cv::remap(toCv(rotated), toCv(rectified), map1, map2, INTER_LINEAR);
+	});
+	bench.time("Rectifier::rectify", opt.frames, [&]() {
+		rectifier.rectify(raws[frame++ % raws.size()], rectified);
+	});
+
+	// --------------------- //
+	// ObjectFinder::update  //
+	// --------------------- //
+
+	vector<ofPixels> rectifiedFrames(raws.size());
+	for (size_t j = 0; j < raws.size(); j++) {
+		rectifier.rectify(raws[j], rectifiedFrames[j]);
+	}
+	ObjectFinder finder;
+	finder.setup("haarcascade_frontalface_default.xml");
+	finder.setPreset(ObjectFinder::Fast);
+	finder.setFindBiggestObject(false);
+	bench.time("ObjectFinder::update", opt.frames, [&]() {
+		finder.update(rectifiedFrames[frame++ % rectifiedFrames.size()]);
+	});
+
+	bench.log();
+	if (!bench.saveJson(opt.out)) {
+		return EXIT_FAILURE;
+	}
+	ofLogNotice() << "results written to " << ofFilePath::getAbsolutePath(opt.out, false);
+
+	return EXIT_SUCCESS;
+}